@@ -15,6 +15,8 @@
 #include <glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
 
+#include "./utils/frustum.h"
+
 /** Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods **/
 enum Camera_Movement {
     FORWARD,
@@ -51,6 +53,8 @@ public:
     float MouseSensitivity;
     float Zoom;
     float ratio = 1.0;
+    // planes of the view of the frame, updated by updateFrustum()
+    Frustum frustum;
 
     /** Constructor with vectors **/
     Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
@@ -84,6 +88,12 @@ public:
         return glm::perspective(fov, ratio, near, far);
     }
 
+    /** Extract the planes of the view from the view and projection matrices, once per frame before the culling **/
+    void updateFrustum()
+    {
+        frustum = Frustum(GetProjectionMatrix() * GetViewMatrix());
+    }
+
     /** Processes input received from any keyboard-like input system.
      *  Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
      *  and allows a translation of the camera
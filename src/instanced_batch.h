@@ -0,0 +1,118 @@
+/**
+* @brief This header file defines the InstancedBatch class drawing many copies of one mesh in a single draw call,
+* the model matrix of each copy is streamed every frame into a per-instance attribute buffer
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef INSTANCED_BATCH_H
+#define INSTANCED_BATCH_H
+
+#include <vector>
+#include <utility>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "./mesh_registry.h"
+#include "./shader_program.h"
+
+/**
+ * @brief Copies of a mesh drawn with glDrawElementsInstanced (glDrawArraysInstanced for a non-indexed mesh).
+ * The programs drawing it are built with INSTANCED 1 and read their model matrix from the attribute 'instance_model'
+**/
+class InstancedBatch{
+public:
+    /** Share the mesh of 'path' with the Objects using it, it's drawn once it's resident **/
+    InstancedBatch(const char* path, VertexFormat format = VERTEX_FLOAT, bool texture = true) : texture(texture) {
+        mesh = MeshRegistry::get().acquire(path, format);
+        glGenBuffers(1, &instance_buffer);
+    }
+
+    InstancedBatch(const InstancedBatch&) = delete;
+    InstancedBatch& operator=(const InstancedBatch&) = delete;
+
+    ~InstancedBatch(){
+        // the buffers are already gone if the context was destroyed first
+        if (glfwGetCurrentContext() == nullptr) return;
+        for (auto& vao : vaos) glDeleteVertexArrays(1, &vao.second);
+        glDeleteBuffers(1, &instance_buffer);
+    }
+
+    /** Stream the model matrices of the instances of the frame, before the first draw of the frame **/
+    void update(const std::vector<glm::mat4>& models){
+        count = (GLsizei)models.size();
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        // grow by doubling so that adding a few instances doesn't change the size of the storage each frame
+        while (capacity < count) capacity = capacity ? capacity * 2 : 64;
+        // orphan the storage of the previous frame, the driver gives a fresh one instead of waiting for the GPU
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        if (count > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(glm::mat4), models.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /** Draw the instances [first, first + number) with 'program', which must be in use. 'number' -1 draws them all **/
+    void draw(ShaderProgram program, GLsizei first = 0, GLsizei number = -1){
+        if (number < 0) number = count - first;
+        if (!mesh->resident || number <= 0) return;
+        program.setVector3f("u_pos_scale", mesh->dequant.pos_scale);
+        program.setVector3f("u_pos_offset", mesh->dequant.pos_offset);
+        GLint att_model = vertexArray(program.ID);
+
+        // the instance attributes start at the first instance drawn, there is no base instance before OpenGL 4.2
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        for (int column = 0; column < 4; column++){
+            size_t offset = (size_t)first * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+            glVertexAttribPointer(att_model + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (mesh->numIndices > 0) glDrawElementsInstanced(GL_TRIANGLES, mesh->numIndices, mesh->indexType, (void*)0, number);
+        else glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->numVertices, number);
+    }
+
+    GLsizei size() const {
+        return count;
+    }
+
+    /** Local bounds of the mesh, false while they aren't known **/
+    bool bounds(glm::vec3& bounds_min, glm::vec3& bounds_max) const {
+        bounds_min = mesh->bounds_min;
+        bounds_max = mesh->bounds_max;
+        return mesh->bounded;
+    }
+
+private:
+    /** Bind the vertex array of 'program', created on its first draw, and return the location of instance_model **/
+    GLint vertexArray(GLuint program){
+        for (auto& vao : vaos){
+            if (vao.first.first == program){
+                glBindVertexArray(vao.second);
+                return vao.first.second;
+            }
+        }
+        GLint att_model = glGetAttribLocation(program, "instance_model");
+        GLuint VAO;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        mesh->attachAttributes(glGetAttribLocation(program, "position"),
+                               texture ? glGetAttribLocation(program, "tex_coord") : -1,
+                               glGetAttribLocation(program, "normal"));
+        // a mat4 attribute takes four locations, one column each, advancing once per instance
+        for (int column = 0; column < 4; column++){
+            glEnableVertexAttribArray(att_model + column);
+            glVertexAttribDivisor(att_model + column, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vaos.push_back(std::make_pair(std::make_pair(program, att_model), VAO));
+        return att_model;
+    }
+
+    MeshHandle mesh;
+    bool texture;
+    GLuint instance_buffer = 0;
+    GLsizei count = 0, capacity = 0;
+    // vertex array of each program, with the location of its instance_model attribute
+    std::vector<std::pair<std::pair<GLuint, GLint>, GLuint>> vaos;
+};
+#endif
@@ -19,18 +19,23 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "./camera.h"
-#include "./simple_shader.h"
-#include "./tess_shader.h"
+#include "./shader_program.h"
+#include "./instanced_batch.h"
 #include "./object.h"
 #include "./terrain_generation.h"
+#include "./tiled_terrain.h"
 #include "./skybox.h"
 #include "./water.h"
 #include "./ground.h"
 #include "./spirit.h"
+#include "./texture_cache.h"
+#include "./uniform_blocks.h"
 #include "./physic.h"
-#include "./particles.h"
+#include "./terrain_collider.h"
+#include "./particle_system.h"
 #include "./utils/debug.h"
 #include "./utils/fps.h"
+#include "./utils/job_system.h"
 
 
 // Functions of the main
@@ -38,10 +43,11 @@ GLFWwindow* setup_window();
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void processInput(GLFWwindow* window, Shader shader,Physic physic, Spirit spirit, ParticleGenerator* particle);
-Object* create_launch_sphere(Shader shader, Physic physic, Spirit spirit);
-void render_scene(Shader shader, Terrain terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos,glm::vec3 light_dir, Object sphere, double now,glm::mat4 lightspace,ParticleGenerator particle);
-void render_depth_scene(Shader shader, Terrain terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos, Object sphere, double now);
+void processInput(GLFWwindow* window, ShaderProgram shader,Physic physic, Spirit spirit, ParticleSystem* particles);
+Object* create_launch_sphere(ShaderProgram shader, Physic physic, Spirit spirit);
+int update_spheres(InstancedBatch& batch, InstancedBatch& shadow_batch, Object& sphere, const Frustum& light_frustum);
+void render_scene(ShaderProgram near_shader, ShaderProgram far_shader, Terrain* terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, InstancedBatch& spheres, int near_spheres);
+void render_depth_scene(ShaderProgram shader, ShaderProgram instanced_shader, Terrain* terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos, InstancedBatch& spheres, double now, const Frustum& light_frustum);
 
 //Parameters
 int speed = 1;
@@ -51,8 +57,18 @@ const int src_height = 700;
 float lastX = src_width / 2.0f;
 float lastY = src_height / 2.0f;
 bool firstMouse = true;
+//Distance from the camera after which the spheres are drawn without shadows
+const float SHADOW_DISTANCE = 40.0f;
 double now;
 bool sphere_launched = false;
+//Emitter of the particles of the spirit, and the trail attached to each launched sphere
+EmitterHandle spirit_emitter = -1;
+EmitterSettings sphere_trail;
+//Objects drawn and skipped by the frustum culling of the color pass and of the shadow pass
+CullingStats view_culling, shadow_culling;
+//Terrain streamed from a pack of tiles instead of the island, with --tiles [pack]
+TiledTerrain* tiled_terrain = nullptr;
+TerrainCollider* terrain_collider = nullptr;
 
 std::vector<Object*> cubes;
 std::vector<Object*> launched_spheres;
@@ -86,26 +102,75 @@ int main(int argc, char* argv[])
 	call_debug();
 #endif
 
-	//Generate the shaders
-	Shader simple_shader(PATH_TO_SHADER "/simple.vs", PATH_TO_SHADER "/simple.fs");
-	Shader depth_shader(PATH_TO_SHADER "/depth/depth.vs", PATH_TO_SHADER "/depth/depth.fs");
-	Shader debugDepthQuad(PATH_TO_SHADER "/depth/debug_depth.vs", PATH_TO_SHADER "/depth/debug_depth.fs");
+	//Generate the shaders, the spheres drawn by the simple shader are compact meshes
+	ShaderProgram simple_shader(PATH_TO_SHADER "/simple.vs", PATH_TO_SHADER "/simple.fs", nullptr, nullptr, nullptr, {{"COMPACT_VERTEX", "1"}});
+	ShaderProgram depth_shader(PATH_TO_SHADER "/depth/depth.vs", PATH_TO_SHADER "/depth/depth.fs");
+	ShaderProgram debugDepthQuad(PATH_TO_SHADER "/depth/debug_depth.vs", PATH_TO_SHADER "/depth/debug_depth.fs");
+
+	//Setup the simple shader parameters
+	simple_shader.use();
+	simple_shader.setFloat("shininess", 40.0f);
+	simple_shader.setFloat("light.ambient_strength", 0.2);
+	simple_shader.setFloat("light.diffuse_strength", 0.7);
+	simple_shader.setFloat("light.specular_strength", 0.9);
+	simple_shader.setFloat("light.constant", 0.9);
+	simple_shader.setFloat("light.linear", 0.7);
+	simple_shader.setFloat("light.quadratic", 0.0);
+	simple_shader.setFloat("dir_light.ambient", 0.0f);
+	simple_shader.setFloat("dir_light.diffuse", 0.6f);
+	simple_shader.setFloat("dir_light.specular", 0.3f);
+	simple_shader.setInteger("shadowMap", UNIT_SHADOW);
+
+	//The permutations drawn every frame are resolved once, they start with the uniforms set above.
+	//The spheres far from the camera use the permutation without the shadow lookups
+	ShaderProgram near_shader = simple_shader.variant({{"INSTANCED", "1"}});
+	ShaderProgram far_shader = simple_shader.variant({{"INSTANCED", "1"}, {"SHADOWS", "0"}});
+	//The spheres are compact meshes, their depth permutation dequantizes the position
+	ShaderProgram instanced_depth_shader = depth_shader.variant({{"INSTANCED", "1"}, {"COMPACT_VERTEX", "1"}});
 	Physic physic = Physic();
 
 
-	//Create all the 3D object of the scene
-	Terrain terrain = Terrain();
+	//Create all the 3D object of the scene, their files are decoded by the workers and uploaded by the main loop
+	double loading_start = glfwGetTime();
+	bool first_frame = true, assets_loaded = false;
+	//The island is only loaded without --tiles, the tiled terrain replaces it
+	Terrain* terrain = nullptr;
+	for (int i = 1; i < argc; i++){
+		if (std::string(argv[i]) != "--tiles") continue;
+		std::string pack = i + 1 < argc ? argv[i + 1] : PATH_TO_TEXTURE "/iceland_heightmap.tiles";
+		tiled_terrain = new TiledTerrain(pack);
+	}
+	if (!tiled_terrain) terrain = new Terrain();
 	Skybox skybox = Skybox();
 	Water water = Water(1000,1.0, 45.0);	
 	Ground ground = Ground();
 	Spirit spirit = Spirit(glm::vec3(1,60,1));
-	ParticleGenerator* particle = new ParticleGenerator(200,&spirit,camera);
+	//Every emitter spawns into the same pool, all the particles are drawn by one instanced draw call.
+	//With --gpu-particles they are updated on the GPU by transform feedback
+	ParticleBackend particle_backend = PARTICLES_CPU;
+	for (int i = 1; i < argc; i++) if (std::string(argv[i]) == "--gpu-particles") particle_backend = PARTICLES_GPU;
+	ParticleSystem* particles = new ParticleSystem(1000, particle_backend);
+	spirit_emitter = particles->addEmitter(spirit.getObject());
+	sphere_trail.rate = 40.0f;
+	sphere_trail.lifetime = 0.8f;
+	sphere_trail.offset = glm::vec3(0.0f);
+	sphere_trail.direction = glm::vec3(0.0f, 1.0f, 0.0f);
+	sphere_trail.mirror = false;
+	sphere_trail.speed_min = 0.0f;
+	sphere_trail.speed_max = 0.5f;
+	sphere_trail.spread = glm::vec3(0.2f);
+	//Every program is built by now, either compiled or loaded from the program cache of a previous launch
+	ProgramCache::get().report();
 
 
 	Object sphere = Object(PATH_TO_OBJECTS "/sphere_smooth.obj");
-	sphere.makeObject(simple_shader);
+	sphere.makeObject(simple_shader,true,VERTEX_COMPACT);
 	sphere.transform.setTranslation(glm::vec3(0,60,0));
 	sphere.transform.updateModelMatrix(sphere.transform.model);
+	//Every sphere shares the same mesh, they're all drawn by one instanced draw call per pass.
+	//The shadow pass has its own instances, the spheres inside the frustum of the light
+	InstancedBatch sphere_batch(PATH_TO_OBJECTS "/sphere_smooth.obj", VERTEX_COMPACT);
+	InstancedBatch shadow_batch(PATH_TO_OBJECTS "/sphere_smooth.obj", VERTEX_COMPACT);
 
 	Object plane_test = Object(PATH_TO_OBJECTS "/plane.obj");
 	plane_test.makeObject(debugDepthQuad,true);
@@ -117,7 +182,7 @@ int main(int argc, char* argv[])
 	for(int i = 0; i < 5; i++){
 		for(int j =0; j <5; j++ ){
 			Object* cube = new Object(PATH_TO_OBJECTS "/sphere_smooth.obj");
-			cube->makeObject(simple_shader);
+			cube->makeObject(simple_shader,true,VERTEX_COMPACT);
 			cube->transform.setTranslation(glm::vec3(i * 3 + j*1.5,60.0,i*2+j *3));
 			cube->transform.updateModelMatrix(cube->transform.model);
 			physic.addSphere(cube);
@@ -137,7 +202,7 @@ int main(int argc, char* argv[])
     glGenFramebuffers(1, &depthMapFBO);
     unsigned int depthMap;
     glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
+    TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D, depthMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -159,24 +224,8 @@ int main(int argc, char* argv[])
 
 	//Setup the texture for the debugger of the shadows
 	debugDepthQuad.use();
-	debugDepthQuad.setInteger("depthMap", 6);
+	debugDepthQuad.setInteger("depthMap", UNIT_SHADOW);
 	
-	//Setup the simple shader parameters
-	simple_shader.use();
-	simple_shader.setFloat("shininess", 40.0f);
-	simple_shader.setFloat("light.ambient_strength", 0.2);
-	simple_shader.setFloat("light.diffuse_strength", 0.7);
-	simple_shader.setFloat("light.specular_strength", 0.9);
-	simple_shader.setFloat("light.constant", 0.9);
-	simple_shader.setFloat("light.linear", 0.7);
-	simple_shader.setFloat("light.quadratic", 0.0);
-	simple_shader.setVector3f("light.light_pos",light_pos);
-	simple_shader.setVector3f("dir_light.direction",light_dir);
-	simple_shader.setFloat("dir_light.ambient", 0.0f);
-	simple_shader.setFloat("dir_light.diffuse", 0.6f);
-	simple_shader.setFloat("dir_light.specular", 0.3f);
-	simple_shader.setInteger("shadowMap", 6);
-
 	// float ambient = 0;
 	// float diffuse = 0;
 	// float specular = 0;
@@ -187,73 +236,112 @@ int main(int argc, char* argv[])
 	glm::vec3 materialColour = glm::vec3(0.17,0.68,0.89);	
 
 	water.setup_water_shader(ambient,diffuse,specular);
-	spirit.setup_spirit_shader(ambient,diffuse,specular,light_pos,light_dir);
-	ground.setup_ground_shader(light_pos);
+	spirit.setup_spirit_shader(ambient,diffuse,specular);
+	ground.setup_ground_shader();
 	
 	glfwSwapInterval(1);
 	while (!glfwWindowShouldClose(window)) {
 		//Setup
-		processInput(window, simple_shader, physic, spirit,particle);
+		processInput(window, simple_shader, physic, spirit,particles);
 		glfwPollEvents();
 		double now = glfwGetTime();
 		double deltaTime = fps.display(now);
+		UploadQueue::get().drain(UPLOAD_BUDGET);
 		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 		auto delta = light_pos + glm::vec3(std::cos(now),0.0,2 * std::sin(now));
 
+        float near_plane = -5.0f, far_plane = 50.0f;
+        glm::mat4 P = glm::ortho(-50.0f, 50.0f, -50.0f, 50.0f, near_plane, far_plane);
+        glm::mat4 V = glm::lookAt(light_dir, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
+		glm::mat4 lightspace = P*V;
+		//Planes of the view of the camera and of the light, the objects outside are skipped by the passes
+		camera->updateFrustum();
+		Frustum light_frustum(lightspace);
+		view_culling.reset();
+		shadow_culling.reset();
+
 		//Update
+		//the island collides once its heightmap is loaded, the tiled terrain replaces it and has no collider
+		if (terrain && !terrain_collider && terrain->residency.ready()) {
+			terrain_collider = new TerrainCollider(terrain->heightmap);
+			terrain_collider->addTo(physic);
+		}
 		physic.update();
-		particle->Update((float)deltaTime,0,spirit.getObject());
+		particles->update((float)deltaTime);
+		if (tiled_terrain) tiled_terrain->update(camera);
+		int near_spheres = update_spheres(sphere_batch, shadow_batch, sphere, light_frustum);
 
 		//Depth pass
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        float near_plane = -5.0f, far_plane = 50.0f;
-        glm::mat4 P = glm::ortho(-50.0f, 50.0f, -50.0f, 50.0f, near_plane, far_plane);
-        glm::mat4 V = glm::lookAt(light_dir, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-		glm::mat4 lightspace = P*V;
+		//Camera, shadow matrix and lights of the frame, read by every shader from the uniform blocks
+		FrameData frame;
+		frame.V = camera->GetViewMatrix();
+		frame.P = camera->GetProjectionMatrix();
+		frame.lightspace = lightspace;
+		frame.view_pos = camera->Position;
+		frame.time = (float)now;
+		UniformBlocks::get().update_frame(frame);
+		LightData lights;
+		lights.light_pos = delta;
+		lights.light_dir = light_dir;
+		UniformBlocks::get().update_lights(lights);
 
         // render scene from light's point of view
-        depth_shader.use();
-        depth_shader.setMatrix4("lightSpaceMatrix", lightspace);
 
         glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
         glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
 		glClear(GL_DEPTH_BUFFER_BIT);
-		render_depth_scene(depth_shader, terrain, skybox, water, spirit, ground, delta, sphere,now);
+		render_depth_scene(depth_shader, instanced_depth_shader, terrain, skybox, water, spirit, ground, delta, shadow_batch, now, light_frustum);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // Color pass
         glViewport(0, 0, src_width, src_width);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		simple_shader.use();
-		simple_shader.setVector3f("light.light_pos",delta);
-		simple_shader.setMatrix4("lightspace",lightspace);
-		glActiveTexture(GL_TEXTURE0+6);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
+		TextureBinder::get().bind(UNIT_SHADOW, GL_TEXTURE_2D, depthMap);
 
-		render_scene(simple_shader,terrain, skybox, water, spirit, ground, delta,light_dir, sphere,now,lightspace,*particle);
+		render_scene(near_shader, far_shader, terrain, skybox, water, spirit, ground, sphere_batch, near_spheres);
 
 		// Used for debbuging the shadows
         // debugDepthQuad.use();
         // debugDepthQuad.setFloat("near_plane", near_plane);
         // debugDepthQuad.setFloat("far_plane", far_plane);
 		// debugDepthQuad.setMatrix4("M", plane_test.transform.model);
-		// debugDepthQuad.setMatrix4("V", camera->GetViewMatrix());
-		// debugDepthQuad.setMatrix4("P", camera->GetProjectionMatrix());
-		// debugDepthQuad.setInteger("depthMap",6);
+		// debugDepthQuad.setInteger("depthMap",UNIT_SHADOW);
 		// plane_test.draw();
 
 		//Draw the particle after the rest to be able to blend the color
-		particle->draw();
+		particles->draw(camera);
+		fps.stats = "drawn " + std::to_string(view_culling.drawn) + " culled " + std::to_string(view_culling.culled) +
+			" - shadow drawn " + std::to_string(shadow_culling.drawn) + " culled " + std::to_string(shadow_culling.culled);
+		if (terrain) fps.stats += " - terrain patches " + std::to_string(terrain->culling.drawn) + " culled " + std::to_string(terrain->culling.culled) +
+			" triangles " + std::to_string(terrain->triangles.primitives);
+		if (tiled_terrain) fps.stats += " - tiles " + std::to_string(tiled_terrain->resident()) + " patches " + std::to_string(tiled_terrain->culling.drawn) +
+			" triangles " + std::to_string(tiled_terrain->triangles.primitives);
 		
 		glfwSwapBuffers(window);
+		if (first_frame){
+			std::cout << "First frame after " << (glfwGetTime() - loading_start) * 1000.0 << " ms" << std::endl;
+			first_frame = false;
+		}
+		if (!assets_loaded && !JobSystem::get().busy() && UploadQueue::get().empty()){
+			std::cout << "All assets resident after " << (glfwGetTime() - loading_start) * 1000.0 << " ms" << std::endl;
+			assets_loaded = true;
+		}
 
 		//Delete the objects that falls bellow the water to avoid lagging
 		cubes.erase(std::remove_if(cubes.begin(), cubes.end(), [](Object* obj){return obj->transform.is_below_level(37);}),cubes.end());
-		launched_spheres.erase(std::remove_if(launched_spheres.begin(), launched_spheres.end(), [](Object* obj){return obj->transform.is_below_level(37);}),launched_spheres.end());
+		launched_spheres.erase(std::remove_if(launched_spheres.begin(), launched_spheres.end(), [particles](Object* obj){
+			if (!obj->transform.is_below_level(37)) return false;
+			particles->removeEmitters(obj);
+			return true;
+		}),launched_spheres.end());
 	}
 
-	terrain.destroy();
+	JobSystem::get().wait_idle();
+	if (terrain_collider) terrain_collider->destroy();
+	if (terrain) terrain->destroy();
+	if (tiled_terrain) tiled_terrain->destroy();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	return 0;
@@ -289,10 +377,10 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset){
 }
 
 /** Create a sphere and launch it in the forward vector of the spirit **/
-Object* create_launch_sphere(Shader shader, Physic physic, Spirit spirit){
+Object* create_launch_sphere(ShaderProgram shader, Physic physic, Spirit spirit){
 	//setup the sphere
 	Object* sphere = new  Object(PATH_TO_OBJECTS "/sphere_smooth.obj");
-	sphere->makeObject(shader);
+	sphere->makeObject(shader,true,VERTEX_COMPACT);
 	glm::vec3 dir = spirit.getObject()->transform.get_forward();
 	glm::vec3 position = spirit.getObject()->transform.getWorldTranslation() + dir * glm::vec3(1,0,1);
 	sphere->transform.setTranslation(position);
@@ -306,75 +394,89 @@ Object* create_launch_sphere(Shader shader, Physic physic, Spirit spirit){
 	return sphere;
 }
 
+/** Stream the model matrices of the spheres inside the view to the batch, the ones close to the camera first, and the ones
+ *  inside the frustum of the light to the shadow batch. Returns how many are close
+**/
+int update_spheres(InstancedBatch& batch, InstancedBatch& shadow_batch, Object& sphere, const Frustum& light_frustum){
+	//Kept between the frames to avoid reallocating them
+	static std::vector<glm::mat4> all, models, far_models, shadow_models;
+	static std::vector<float> x, y, z, radius;
+	static std::vector<uint8_t> in_view, in_light;
+	all.clear();
+	all.push_back(sphere.transform.model);
+	for (Object* obj : cubes) all.push_back(obj->transform.model);
+	for (Object* obj : launched_spheres) all.push_back(obj->transform.model);
+
+	//Bounding sphere of each instance, tested four at a time against the two frustums
+	glm::vec3 bounds_min, bounds_max;
+	bool bounded = batch.bounds(bounds_min, bounds_max);
+	x.resize(all.size()); y.resize(all.size()); z.resize(all.size()); radius.resize(all.size());
+	in_view.assign(all.size(), 1);
+	in_light.assign(all.size(), 1);
+	for (size_t i = 0; i < all.size(); i++){
+		glm::vec3 center;
+		bounding_sphere(all[i], bounds_min, bounds_max, center, radius[i]);
+		x[i] = center.x; y[i] = center.y; z[i] = center.z;
+	}
+	if (bounded){
+		camera->frustum.intersects(x.data(), y.data(), z.data(), radius.data(), all.size(), in_view.data());
+		light_frustum.intersects(x.data(), y.data(), z.data(), radius.data(), all.size(), in_light.data());
+	}
+
+	models.clear();
+	far_models.clear();
+	shadow_models.clear();
+	for (size_t i = 0; i < all.size(); i++){
+		if (shadow_culling.count(in_light[i])) shadow_models.push_back(all[i]);
+		if (!view_culling.count(in_view[i])) continue;
+		float distance = glm::length(glm::vec3(x[i], y[i], z[i]) - camera->Position);
+		(distance > SHADOW_DISTANCE ? far_models : models).push_back(all[i]);
+	}
+
+	int near_spheres = (int)models.size();
+	models.insert(models.end(), far_models.begin(), far_models.end());
+	batch.update(models);
+	shadow_batch.update(shadow_models);
+	return near_spheres;
+}
+
 /** Render the color pass of the scene. it draws all the 3D objects of the scene **/
-void render_scene(Shader shader,Terrain terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos,glm::vec3 light_dir, Object sphere, double now,glm::mat4 lightspace,ParticleGenerator particle){
+void render_scene(ShaderProgram near_shader, ShaderProgram far_shader, Terrain* terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, InstancedBatch& spheres, int near_spheres){
 	glm::vec3 materialColour = glm::vec3(0.17,0.68,0.89);	
 
-	terrain.draw(*camera,light_dir);
-	skybox.draw(*camera);
+	if (tiled_terrain) tiled_terrain->draw(camera);
+	else terrain->draw(camera);
+	skybox.draw();
 	
-	ground.set_lightspace(lightspace);
-	ground.draw(camera);
-	water.draw(*camera,materialColour,light_pos,now, skybox.getSkyTexture());
-
-	spirit.draw(camera,light_pos);
-
-	shader.use();
-	shader.setVector3f("u_view_pos",camera->Position);
-	shader.setMatrix4("M", sphere.transform.model);
-	shader.setMatrix4("itM", glm::inverseTranspose(sphere.transform.model));
-	shader.setVector3f("materialColour", materialColour);
-	shader.setMatrix4("V", camera->GetViewMatrix());
-	shader.setMatrix4("P", camera->GetProjectionMatrix());
-	sphere.draw();
-
-	for(int i = 0; i < cubes.size(); i++){
-		Object * obj = cubes[i];
-		shader.setMatrix4("M", obj->transform.model);
-		shader.setMatrix4("itM", glm::inverseTranspose(obj->transform.model));
-		shader.setVector3f("materialColour", materialColour);
-		shader.setMatrix4("V", camera->GetViewMatrix());
-		shader.setMatrix4("P", camera->GetProjectionMatrix());
-		obj->draw();
-	}
-
-	for(int i = 0; i < launched_spheres.size(); i++){
-		Object * obj = launched_spheres[i];
-		shader.setMatrix4("M", obj->transform.model);
-		shader.setMatrix4("itM", glm::inverseTranspose(obj->transform.model));
-		shader.setVector3f("materialColour", materialColour);
-		shader.setMatrix4("V", camera->GetViewMatrix());
-		shader.setMatrix4("P", camera->GetProjectionMatrix());
-		obj->draw();
+	//The objects outside of the view of the camera are skipped
+	if (view_culling.count(ground.getObject()->inFrustum(camera->frustum))) ground.draw();
+	if (view_culling.count(water.plane.inFrustum(camera->frustum))) water.draw(materialColour, skybox.getSkyTexture());
+
+	if (view_culling.count(spirit.getObject()->inFrustum(camera->frustum))) spirit.draw();
+
+	//The spheres far from the camera are after the others in the batch
+	near_shader.use();
+	near_shader.setVector3f("materialColour", materialColour);
+	spheres.draw(near_shader, 0, near_spheres);
+	if (spheres.size() > near_spheres){
+		far_shader.use();
+		far_shader.setVector3f("materialColour", materialColour);
+		spheres.draw(far_shader, near_spheres);
 	}
 }
 
 /** Render the depth pass of the scene. it draws all the 3D objects of the scene that interact with shadows**/
-void render_depth_scene(Shader shader, Terrain terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos, Object sphere, double now){
-	glm::vec3 materialColour = glm::vec3(0.17,0.68,0.89);
-
-	ground.draw_depth(camera, shader);
-	spirit.draw_depth(camera, shader);
-
-	shader.use();
-	shader.setMatrix4("M", sphere.transform.model);
-	sphere.draw();
+void render_depth_scene(ShaderProgram shader, ShaderProgram instanced_shader, Terrain* terrain, Skybox skybox, Water water, Spirit spirit, Ground ground, glm::vec3 light_pos, InstancedBatch& spheres, double now, const Frustum& light_frustum){
+	//The objects outside of the orthographic frustum of the light can't cast a shadow in the shadow map
+	if (shadow_culling.count(ground.getObject()->inFrustum(light_frustum))) ground.draw_depth(camera, shader);
+	if (shadow_culling.count(spirit.getObject()->inFrustum(light_frustum))) spirit.draw_depth(camera, shader);
 
-	for(int i = 0; i < cubes.size(); i++){
-		Object * obj = cubes[i];
-		shader.setMatrix4("M", obj->transform.model);
-		obj->draw();
-	}
-
-	for(int i = 0; i < launched_spheres.size(); i++){
-		Object * obj = launched_spheres[i];
-		shader.setMatrix4("M", obj->transform.model);
-		obj->draw();
-	}
+	instanced_shader.use();
+	spheres.draw(instanced_shader);
 }
 
 /** Handle the input of the keyboard and launch the corresponding function **/
-void processInput(GLFWwindow* window, Shader shader,Physic physic, Spirit spirit, ParticleGenerator* particle){
+void processInput(GLFWwindow* window, ShaderProgram shader,Physic physic, Spirit spirit, ParticleSystem* particles){
 	//Handle the camera input
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)		glfwSetWindowShouldClose(window, true);
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)			camera->ProcessKeyboardMovement(LEFT, 0.1);
@@ -448,13 +550,15 @@ void processInput(GLFWwindow* window, Shader shader,Physic physic, Spirit spirit
 	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS){
 		if (!sphere_launched){
 			Object* sphere = create_launch_sphere(shader,physic,spirit);
-			particle->Update(0,50,sphere);
+			particles->burst(sphere, 50);
+			particles->addEmitter(sphere, sphere_trail);
 			now = glfwGetTime();
 			sphere_launched = true;
 		}else{
 			if(glfwGetTime()- now > 1){
 				Object* sphere = create_launch_sphere(shader,physic,spirit);
-				particle->Update(0,50,spirit.getObject());
+				particles->burst(spirit_emitter, 50);
+				particles->addEmitter(sphere, sphere_trail);
 				now = glfwGetTime();
 			}
 		}
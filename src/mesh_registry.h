@@ -0,0 +1,251 @@
+/**
+* @brief This header file defines the GpuMesh struct and the MeshRegistry class
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include "./shader_program.h"
+#include "./utils/mesh_cache.h"
+#include "./utils/vertex_compression.h"
+#include "./utils/job_system.h"
+
+/** Layout of the vertices in the vertex buffer, chosen per mesh at upload time **/
+enum VertexFormat {
+	VERTEX_FLOAT,      // 32 bytes Vertex
+	VERTEX_COMPACT     // 16 bytes CompactVertex, dequantized in the vertex shader
+};
+
+/**
+ * @brief CPU side of a mesh prepared by a worker thread, everything except the OpenGL calls is done before the upload
+**/
+struct MeshStaging {
+	MeshData data;
+	VertexFormat format = VERTEX_FLOAT;
+	std::vector<CompactVertex> compact;
+	VertexDequantization dequant;
+
+	/** Compute the bounds and quantize the vertices if the compact format is requested **/
+	void prepare(VertexFormat vertexFormat){
+		format = vertexFormat;
+		data.compute_bounds();
+		if (format == VERTEX_COMPACT) dequant = compress_vertices(data.vertex_data, data.vertex_count, data.bounds_min, data.bounds_max, compact);
+	}
+};
+
+/**
+ * @brief Buffers of a mesh living on the GPU. It's shared by every Object drawing the same geometry
+ * and the buffers are deleted when the last Object using it is destroyed
+**/
+struct GpuMesh {
+	std::string path;
+	GLuint VBO = 0, EBO = 0;
+	int numVertices = 0;
+	int numIndices = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	VertexFormat format = VERTEX_FLOAT;
+	VertexDequantization dequant;
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	// false while the bounds are unknown, the mesh is then never culled
+	bool bounded = false;
+	// false until the buffers are filled, the mesh is not drawn before
+	bool resident = false;
+
+	GpuMesh(){}
+	GpuMesh(const GpuMesh&) = delete;
+	GpuMesh& operator=(const GpuMesh&) = delete;
+
+	~GpuMesh(){
+		// the buffers are already gone if the context was destroyed first
+		if (glfwGetCurrentContext() == nullptr) return;
+		for (auto& vao : vaos) glDeleteVertexArrays(1, &vao.second);
+		if (VBO) glDeleteBuffers(1, &VBO);
+		if (EBO) glDeleteBuffers(1, &EBO);
+	}
+
+	/** Create the vertex and element buffers from raw data **/
+	void upload(const void* vertices, size_t vertexBytes, int vertexCount, const void* indices, int indexCount, int indexSize){
+		numVertices = vertexCount;
+		numIndices = indexCount;
+		resident = true;
+		indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+		// the uploads run between two frames, binding the element buffer must not touch the vertex array drawn last
+		glBindVertexArray(0);
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (indexCount > 0) {
+			glGenBuffers(1, &EBO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexSize * indexCount, indices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+	}
+
+	/** Create the buffers from a mesh prepared by a worker, the float format uploads the parsed or mapped data as is **/
+	void upload(const MeshStaging& staging){
+		const MeshData& mesh = staging.data;
+		format = staging.format;
+		dequant = staging.dequant;
+		bounds_min = mesh.bounds_min;
+		bounds_max = mesh.bounds_max;
+		bounded = true;
+		if (format == VERTEX_COMPACT)
+			upload(staging.compact.data(), sizeof(CompactVertex) * mesh.vertex_count, mesh.vertex_count, mesh.index_data, mesh.index_count, mesh.index_size);
+		else
+			upload(mesh.vertex_data, sizeof(Vertex) * mesh.vertex_count, mesh.vertex_count, mesh.index_data, mesh.index_count, mesh.index_size);
+	}
+
+	/** Return the vertex array linking the Vertex layout to the attributes of 'program'. It's created once per attribute layout **/
+	GLuint vertexArray(GLuint program, bool texture = true){
+		// the objects copied every frame ask again for their vertex array, skip the attribute queries for a known program
+		uint32_t program_key = program << 1 | (texture ? 1u : 0u);
+		for (auto& vao : programs)
+			if (vao.first == program_key) return vao.second;
+
+		GLint att_pos = glGetAttribLocation(program, "position");
+		GLint att_tex = texture ? glGetAttribLocation(program, "tex_coord") : -1;
+		GLint att_col = glGetAttribLocation(program, "normal");
+		uint32_t key = (uint32_t)(att_pos & 0xff) | (uint32_t)(att_tex & 0xff) << 8 | (uint32_t)(att_col & 0xff) << 16;
+		for (auto& vao : vaos){
+			if (vao.first == key) {
+				programs.push_back(std::make_pair(program_key, vao.second));
+				return vao.second;
+			}
+		}
+
+		GLuint VAO;
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+		attachAttributes(att_pos, att_tex, att_col);
+
+		//desactive the buffer (the element buffer stays attached to the VAO)
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		vaos.push_back(std::make_pair(key, VAO));
+		programs.push_back(std::make_pair(program_key, VAO));
+		return VAO;
+	}
+
+	/** Attach the buffers of the mesh to the vertex array currently bound, the attributes at -1 are skipped (no uv, or a depth program without normal) **/
+	void attachAttributes(GLint att_pos, GLint att_tex, GLint att_col){
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (EBO) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		if (format == VERTEX_COMPACT) {
+			// normalized integers, the shader applies the dequantization of the position
+			glEnableVertexAttribArray(att_pos);
+			glVertexAttribPointer(att_pos, 3, GL_SHORT, true, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+			if (att_tex >= 0) {
+				glEnableVertexAttribArray(att_tex);
+				glVertexAttribPointer(att_tex, 2, GL_UNSIGNED_SHORT, true, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Texture));
+			}
+			if (att_col >= 0) {
+				glEnableVertexAttribArray(att_col);
+				glVertexAttribPointer(att_col, 3, GL_BYTE, true, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+			}
+		}
+		else {
+			glEnableVertexAttribArray(att_pos);
+			glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+			if (att_tex >= 0) {
+				glEnableVertexAttribArray(att_tex);
+				glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, Texture));
+			}
+			if (att_col >= 0) {
+				glEnableVertexAttribArray(att_col);
+				glVertexAttribPointer(att_col, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+			}
+		}
+	}
+
+	/** Keep a vertex array created outside of the mesh so that it's deleted with it **/
+	void adoptVertexArray(GLuint VAO){
+		vaos.push_back(std::make_pair(0xffffffffu, VAO));
+	}
+
+private:
+	std::vector<std::pair<uint32_t, GLuint>> vaos;
+	std::vector<std::pair<uint32_t, GLuint>> programs;
+};
+
+typedef std::shared_ptr<GpuMesh> MeshHandle;
+
+/**
+ * @brief Fill 'mesh' with 'load' and prepare it on a worker thread, then upload it on the OpenGL thread.
+ * The mesh stays non resident if 'load' fails
+**/
+inline void upload_mesh_async(MeshHandle mesh, std::function<bool(MeshData&)> load, VertexFormat format){
+	std::shared_ptr<MeshStaging> staging = std::make_shared<MeshStaging>();
+	std::shared_ptr<bool> loaded = std::make_shared<bool>(false);
+	JobSystem::get().submit([staging, loaded, load, format](){
+		*loaded = load(staging->data);
+		if (*loaded) staging->prepare(format);
+	}, [mesh, staging, loaded](){
+		if (*loaded) mesh->upload(*staging);
+	});
+}
+
+/**
+ * @brief Reference-counted registry of the meshes loaded from a file. The file is parsed and uploaded
+ * once and every later request for the same path returns the same GPU buffers while they're still in use
+**/
+class MeshRegistry{
+public:
+	static MeshRegistry& get(){
+		static MeshRegistry registry;
+		return registry;
+	}
+
+	/** Return the mesh of 'path' in the requested vertex format. If no Object is using it yet, it's loaded by a worker
+	 *  and the returned mesh becomes resident once the upload queue reaches it
+	**/
+	MeshHandle acquire(const std::string& path, VertexFormat format = VERTEX_FLOAT, bool verbose = false){
+		std::string key = format == VERTEX_COMPACT ? path + "#compact" : path;
+		auto it = meshes.find(key);
+		if (it != meshes.end()) {
+			if (MeshHandle mesh = it->second.lock()) return mesh;
+		}
+
+		MeshHandle mesh = std::make_shared<GpuMesh>();
+		mesh->path = path;
+		upload_mesh_async(mesh, [path, verbose](MeshData& data){
+			if (!load_mesh(path.c_str(), data, verbose)) return false;
+			if (verbose) std::cout << "Loaded " << path << " with " << data.vertex_count << " vertices" << std::endl;
+			return true;
+		}, format);
+		meshes[key] = mesh;
+		return mesh;
+	}
+
+	/** Number of meshes currently alive **/
+	size_t size(){
+		size_t count = 0;
+		for (auto& entry : meshes)
+			if (!entry.second.expired()) count++;
+		return count;
+	}
+
+private:
+	MeshRegistry(){}
+	std::unordered_map<std::string, std::weak_ptr<GpuMesh>> meshes;
+};
+#endif
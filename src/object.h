@@ -10,24 +10,17 @@
 #define OBJECT_H
 
 #include<iostream>
-#include <fstream>
 #include <string>
-#include <sstream>
 #include <vector>
+#include <functional>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
 #include <btBulletDynamicsCommon.h>
 #include "./utils/transform.h"
-
-
-/**The struct that defines a vertex**/
-struct Vertex {
-	glm::vec3 Position;
-	glm::vec2 Texture;
-	glm::vec3 Normal;
-};
+#include "./mesh_registry.h"
+#include "./utils/frustum.h"
 
 /**
  * @brief Class that parse ´.obj´ file and associate the mesh extracted to buffers and shaders. 
@@ -36,17 +29,15 @@ struct Vertex {
 class Object
 {
 public:
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec2> textures;
-	std::vector<glm::vec3> normals;
-	std::vector<Vertex> vertices;
+	std::string path = "";
+	MeshHandle mesh;
+	GLuint VAO = 0;
+	// program and texture flag used to create the vertex array once the mesh is resident
+	GLuint program = 0;
+	bool texture = true;
 
 	std::string name = "";
 
-	int numVertices;
-
-	GLuint VBO, VAO;
-
 	Transform transform;
 	btRigidBody* rigid;
 	bool verbose = false;
@@ -56,194 +47,55 @@ public:
 		transform = Transform();
 	}
 
-	/** Read an ´.obj´ file and parse it correctly to create an array of vertex**/
+	/** Creates an instance of the mesh stored in an ´.obj´ file. The file is only read by makeObject
+	 *  if no other Object is already using it
+	**/
 	Object(const char* path, bool verbose = false) {
 		transform = Transform();
+		this->path = path;
 		this->verbose = verbose;
-		std::ifstream infile(path);
-		if (verbose) std::cout << path << std::endl;
-		std::string line;
-		while (std::getline(infile, line))
-		{
-			std::istringstream iss(line);
-			std::string indice;
-			iss >> indice;
-			//std::cout << "indice : " << indice << std::endl;
-			if (indice == "v") {
-				float x, y, z;
-				iss >> x >> y >> z;
-				positions.push_back(glm::vec3(x, y, z));
-
-			}
-			else if (indice == "vn") {
-				float x, y, z;
-				iss >> x >> y >> z;
-				normals.push_back(glm::vec3(x, y, z));
-			}
-			else if (indice == "vt") {
-				float u, v;
-				iss >> u >> v;
-				textures.push_back(glm::vec2(u, v));
-			}
-			else if (indice == "f") {
-				std::string f1, f2, f3;
-				iss >> f1 >> f2 >> f3;
-
-				std::string p, t, n;
-
-				//for face 1
-				Vertex v1;
-
-				p = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
-
-				t = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
-
-				n = f1.substr(0, f1.find("/"));
-
-
-				v1.Position = positions.at(std::stof(p) - 1);
-				v1.Normal = normals.at(std::stof(n) - 1);
-				v1.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v1);
-
-				//for face 12
-				Vertex v2;
-
-				p = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
-
-				t = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
-
-				n = f2.substr(0, f2.find("/"));
-
-
-				v2.Position = positions.at(std::stof(p) - 1);
-				v2.Normal = normals.at(std::stof(n) - 1);
-				v2.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v2);
-
-				//for face 3
-				Vertex v3;
-
-				p = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
-
-				t = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
-
-				n = f3.substr(0, f3.find("/"));
-
-
-				v3.Position = positions.at(std::stof(p) - 1);
-				v3.Normal = normals.at(std::stof(n) - 1);
-				v3.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v3);
-			}
-		}
-		if(verbose)	std::cout << "Load model with " << vertices.size() << std::endl;
-
-		infile.close();
-		numVertices = vertices.size();
 	}
 
 
-	/** Parse the array of vertices into an OpenGL readable format
-	 *  and put them in the correct buffer. Link the shader and the texture if used
+	/** Retrieve the shared mesh from the registry and link the shader and the texture if used. The file is loaded
+	 *  in the background, the object isn't drawn until its mesh is resident.
+	 *  VERTEX_COMPACT halves the size of the vertices, the shader must then be drawn through draw(shader)
 	**/
-	void makeObject(Shader shader, bool texture = true) {
-		float* data = new float[8 * numVertices];
-		for (int i = 0; i < numVertices; i++) {
-			Vertex v = vertices.at(i);
-			data[i * 8] = v.Position.x;
-			data[i * 8 + 1] = v.Position.y;
-			data[i * 8 + 2] = v.Position.z;
-
-			data[i * 8 + 3] = v.Texture.x;
-			data[i * 8 + 4] = v.Texture.y;
-
-			data[i * 8 + 5] = v.Normal.x;
-			data[i * 8 + 6] = v.Normal.y;
-			data[i * 8 + 7] = v.Normal.z;
-		}
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-
-		//define VBO and VAO as active buffer and active vertex array
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, data, GL_STATIC_DRAW);
-
-		auto att_pos = glGetAttribLocation(shader.ID, "position");
-		glEnableVertexAttribArray(att_pos);
-		glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
-
-		if (texture) {
-			auto att_tex = glGetAttribLocation(shader.ID, "tex_coord");
-			glEnableVertexAttribArray(att_tex);
-			glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-		}
-		auto att_col = glGetAttribLocation(shader.ID, "normal");
-		glEnableVertexAttribArray(att_col);
-		glVertexAttribPointer(att_col, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-		
-		//desactive the buffer
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		delete[] data;
+	void makeObject(ShaderProgram shader, bool texture = true, VertexFormat format = VERTEX_FLOAT) {
+		mesh = MeshRegistry::get().acquire(path, format, verbose);
+		program = shader.ID;
+		this->texture = texture;
 	}
 
-	/** Parse the array of vertices that was created by hand into an OpenGL readable format
-	 *  and put them in the correct buffer. Link the shader and the texture if used
-	**/
-	void makeObject(std::vector<Vertex> vertices, int numVertices, Shader shader, bool texture = true) {
-		
-		this->numVertices = numVertices;
+	/** Put the array of vertices that was created by hand in the correct buffer. Link the shader and the texture if used **/
+	void makeObject(std::vector<Vertex> vertices, int numVertices, ShaderProgram shader, bool texture = true) {
 		if (verbose) printf("Load model with %d \n", numVertices);
-		float* data = new float[8 * numVertices];
-		for (int i = 0; i < numVertices; i++) {
-			Vertex v = vertices.at(i);
-			data[i * 8] = v.Position.x;
-			data[i * 8 + 1] = v.Position.y;
-			data[i * 8 + 2] = v.Position.z;
-
-			data[i * 8 + 3] = v.Texture.x;
-			data[i * 8 + 4] = v.Texture.y;
-
-			data[i * 8 + 5] = v.Normal.x;
-			data[i * 8 + 6] = v.Normal.y;
-			data[i * 8 + 7] = v.Normal.z;
-		}
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-
-		//define VBO and VAO as active buffer and active vertex array
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, data, GL_STATIC_DRAW);
+		mesh = std::make_shared<GpuMesh>();
+		mesh->upload(vertices.data(), sizeof(Vertex) * numVertices, numVertices, nullptr, 0, 0);
+		vertex_bounds(vertices.data(), numVertices, mesh->bounds_min, mesh->bounds_max);
+		mesh->bounded = true;
+		VAO = mesh->vertexArray(shader.ID, texture);
+	}
 
-		auto att_pos = glGetAttribLocation(shader.ID, "position");
-		glEnableVertexAttribArray(att_pos);
-		glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
-		
-		if (texture) {
-			auto att_tex = glGetAttribLocation(shader.ID, "tex_coord");
-			glEnableVertexAttribArray(att_tex);
-			glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));	
-		}
-		auto att_col = glGetAttribLocation(shader.ID, "normal");
-		glEnableVertexAttribArray(att_col);
-		glVertexAttribPointer(att_col, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-		
-		//desactive the buffer
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+	/** Build an indexed mesh by hand with 'build' on a worker thread and upload it in the background.
+	 *  Link the shader and the texture if used
+	**/
+	void makeObject(std::function<void(std::vector<Vertex>&, std::vector<uint32_t>&)> build, ShaderProgram shader, bool texture = true,
+	                VertexFormat format = VERTEX_FLOAT) {
+		bool verbose = this->verbose;
+		mesh = std::make_shared<GpuMesh>();
+		upload_mesh_async(mesh, [build, verbose](MeshData& data){
+			build(data.vertices, data.indices);
+			if (verbose) printf("Load model with %d vertices and %d indices\n", (int)data.vertices.size(), (int)data.indices.size());
+			data.use_owned_data();
+			return true;
+		}, format);
+		program = shader.ID;
+		this->texture = texture;
 	}
 
 	/** Create the vertex, texture and normal coordinate as well as the tangent, bitangent for a ground and link them to the buffer **/
-	void makeGround(Shader shader){
+	void makeGround(ShaderProgram shader){
 		// positions
 		glm::vec3 pos1(-1.0f, 1.0f, 1.0f);
 		glm::vec3 pos2(-1.0f, 1.0f,-1.0f);
@@ -307,11 +159,15 @@ public:
 			pos4.x, pos4.y, pos4.z, nm.x, nm.y, nm.z, uv4.x, uv4.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z
 		};
 		// configure plane VAO
+		mesh = std::make_shared<GpuMesh>();
+		mesh->upload(quadVertices, sizeof(quadVertices), 6, nullptr, 0, 0);
+		mesh->bounds_min = glm::vec3(-1.0f, 1.0f, -1.0f);
+		mesh->bounds_max = glm::vec3(1.0f, 1.0f, 1.0f);
+		mesh->bounded = true;
 		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
+		mesh->adoptVertexArray(VAO);
 		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
 
 		auto pos = glGetAttribLocation(shader.ID, "aPos");
 		glEnableVertexAttribArray(pos);
@@ -335,10 +191,32 @@ public:
 
 	}
 
-	/**	Bind your vertex arrays and call glDrawArrays **/
+	/**	Bind your vertex arrays and call glDrawElements (or glDrawArrays for a non-indexed mesh) **/
 	void draw() {
+		if (!mesh || !mesh->resident) return;
+		if (!VAO) VAO = mesh->vertexArray(program, texture);
 		glBindVertexArray(this->VAO);
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
+		if (mesh->numIndices > 0) glDrawElements(GL_TRIANGLES, mesh->numIndices, mesh->indexType, (void*)0);
+		else glDrawArrays(GL_TRIANGLES, 0, mesh->numVertices);
+	}
+
+	/**	Set the dequantization uniforms of the mesh (identity for the float format) and draw it **/
+	void draw(ShaderProgram shader) {
+		if (!mesh || !mesh->resident) return;
+		shader.setVector3f("u_pos_scale", mesh->dequant.pos_scale);
+		shader.setVector3f("u_pos_offset", mesh->dequant.pos_offset);
+		draw();
+	}
+
+	/** True if the bounding sphere of the mesh placed by the model matrix is at least partly in 'frustum'.
+	 *  An object whose bounds aren't known yet is always drawn
+	**/
+	bool inFrustum(const Frustum& frustum) {
+		if (!mesh || !mesh->bounded) return true;
+		glm::vec3 center;
+		float radius;
+		bounding_sphere(transform.model, mesh->bounds_min, mesh->bounds_max, center, radius);
+		return frustum.intersects(center, radius);
 	}
 
 	void setName(std::string name){
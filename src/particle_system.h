@@ -0,0 +1,146 @@
+/**
+* @brief This header file defines the ParticleSystem class, the emitters of the scene sharing one pool of particles
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "./object.h"
+#include "./particles.h"
+
+/** Index of an emitter in its ParticleSystem, -1 for no emitter **/
+typedef int EmitterHandle;
+
+/** An emitter follows the transform of its object, it's only a few parameters : the particles live in the system **/
+struct ParticleEmitter {
+    Object* object = nullptr;
+    EmitterSettings settings;
+    // particles owed by the rate that didn't make a whole particle yet
+    float pending = 0.0f;
+};
+
+/**
+ * @brief Every emitter of the scene spawns into the same pool of particles, updated by one pass of the SIMD kernel
+ * and drawn by one instanced draw call whatever the number of emitters. When the pool is full the new particles
+ * replace live ones in turn (not the oldest : the pool moves the particles when it removes the dead ones), a burst
+ * never fails. With the GPU backend the particles stay in the buffers of GpuParticles, each emitter spawning
+ * through its own transform feedback pass, and the slots are reused as a ring
+**/
+class ParticleSystem{
+public:
+    ParticleSystem(unsigned int capacity, ParticleBackend backend = PARTICLES_CPU) : pool(backend == PARTICLES_GPU ? 0 : capacity) {
+        if (backend == PARTICLES_GPU)
+            gpu = std::make_shared<GpuParticles>(capacity, batch.quadVBO, batch.shader.variant({{"PARTICLE_LIFE", "1"}}));
+    }
+
+    /** Attach an emitter to 'object', it spawns 'settings.rate' particles per second until it's removed **/
+    EmitterHandle addEmitter(Object* object, const EmitterSettings& settings = EmitterSettings()){
+        ParticleEmitter emitter;
+        emitter.object = object;
+        emitter.settings = settings;
+        // the slots of the removed emitters are reused, the handles of the others stay valid
+        for (size_t i = 0; i < emitters.size(); i++){
+            if (emitters[i].object == nullptr) {
+                emitters[i] = emitter;
+                return (EmitterHandle)i;
+            }
+        }
+        emitters.push_back(emitter);
+        return (EmitterHandle)(emitters.size() - 1);
+    }
+
+    void removeEmitter(EmitterHandle handle){
+        if (valid(handle)) emitters[handle].object = nullptr;
+    }
+
+    /** Remove the emitters attached to 'object', before it's destroyed or leaves the scene **/
+    void removeEmitters(Object* object){
+        for (ParticleEmitter& emitter : emitters)
+            if (emitter.object == object) emitter.object = nullptr;
+    }
+
+    ParticleEmitter* emitter(EmitterHandle handle){
+        return valid(handle) ? &emitters[handle] : nullptr;
+    }
+
+    /** Spawn 'count' particles at once from the emitter 'handle' with its settings **/
+    void burst(EmitterHandle handle, unsigned int count){
+        if (valid(handle)) burst(emitters[handle].object, count, emitters[handle].settings);
+    }
+
+    /** Spawn 'count' particles at 'object' with 'settings', without an emitter (an impact, a launch) **/
+    void burst(Object* object, unsigned int count, const EmitterSettings& settings = EmitterSettings()){
+        spawn(object->transform.getWorldTranslation(), count, settings);
+    }
+
+    /** Spawn the particles of the rate of each emitter, then move the particles of every emitter **/
+    void update(float dt){
+        for (ParticleEmitter& emitter : emitters){
+            if (emitter.object == nullptr || emitter.settings.rate <= 0.0f) continue;
+            emitter.pending += emitter.settings.rate * dt;
+            float whole = std::floor(emitter.pending);
+            emitter.pending -= whole;
+            spawn(emitter.object->transform.getWorldTranslation(), (unsigned int)whole, emitter.settings);
+        }
+        if (gpu) gpu->update(dt, 0, glm::vec3(0.0f), EmitterSettings());
+        else pool.update(dt);
+    }
+
+    /** Sort the particles back to front for alpha blending (smoke, dust), PARTICLES_UNSORTED for additive blending.
+     *  Only the CPU backend can be sorted
+    **/
+    void setSort(ParticleSort mode){
+        batch.setSort(gpu ? PARTICLES_UNSORTED : mode);
+    }
+
+    /** Draw the particles of every emitter with one instanced quad, after the opaque objects. The sorted modes need the 'camera' **/
+    void draw(const Camera* camera = nullptr){
+        if (!gpu) {
+            batch.draw(pool, camera);
+            return;
+        }
+        if (!batch.texture->resident) return;
+        batch.begin(gpu->drawShader());
+        gpu->draw();
+        batch.end();
+    }
+
+    /** Number of live particles, always 0 for the GPU backend whose particles are never read back **/
+    unsigned int size() const {
+        return pool.size();
+    }
+
+private:
+    bool valid(EmitterHandle handle) const {
+        return handle >= 0 && handle < (EmitterHandle)emitters.size() && emitters[handle].object != nullptr;
+    }
+
+    void spawn(glm::vec3 origin, unsigned int count, const EmitterSettings& settings){
+        if (count == 0) return;
+        // a pass without time step only writes the new particles
+        if (gpu) {
+            gpu->update(0.0f, count, origin + settings.offset, settings);
+            return;
+        }
+        for (unsigned int i = 0; i < count; i++){
+            int slot = pool.spawn();
+            if (slot >= 0) emit_particle(pool, (unsigned int)slot, origin, settings, random);
+        }
+    }
+
+    ParticlePool pool;
+    ParticleRandom random;
+    ParticleBatch batch;
+    std::vector<ParticleEmitter> emitters;
+    // set for the GPU backend, the pool then stays empty
+    std::shared_ptr<GpuParticles> gpu;
+};
+#endif
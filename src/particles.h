@@ -10,13 +10,19 @@
 #define PARTICLE_H
 
 #include <vector>
+#include <cstddef>
+#include <memory>
+#include <algorithm>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include "./simple_shader.h"
+#include "./shader_program.h"
 #include "./spirit.h"
 #include "./camera.h"
+#include "./texture_cache.h"
+#include "./utils/particle_pool.h"
+#include "./utils/particle_sort.h"
 
-/** Represents a single particle and its state **/
+/** Represents a single particle and its state, the layout of the particles kept on the GPU **/
 struct Particle {
     glm::vec3 Position, Velocity;
     glm::vec4 Color;
@@ -25,81 +31,131 @@ struct Particle {
     Particle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(10.0f) {}
 };
 
-/** @brief ParticleGenerator acts as a container for rendering a large number of 
- * particles by repeatedly spawning and updating particles and killing 
- * them after a given amount of time.
+/** Per-instance attributes of a live particle, streamed each frame to the instance buffer **/
+struct ParticleInstance {
+    glm::vec3 position;
+    glm::vec4 color;
+};
+
+static_assert(sizeof(Particle) == 11 * sizeof(float), "the GPU particles read the Particle struct as 11 packed floats");
+
+/** How an emitter spawns its particles, the defaults are the particles of the spirit **/
+struct EmitterSettings {
+    // particles spawned per second, 0 for an emitter only used for bursts
+    float rate = 0.0f;
+    float lifetime = 3.0f;
+    // spawn point relative to the position of the object
+    glm::vec3 offset = glm::vec3(-0.5f, 2.0f, 0.0f);
+    // the velocity is 'direction' (or its mirror in x and z for half the particles) times a random speed,
+    // plus a random vector in [-spread, spread]
+    glm::vec3 direction = glm::vec3(0.2f, 0.4f, -0.2f);
+    bool mirror = true;
+    float speed_min = -2.5f, speed_max = 2.5f;
+    glm::vec3 spread = glm::vec3(0.0f);
+    // grey level of the particle, above 1 it's brighter than the sprite
+    float shade_min = 0.5f, shade_max = 1.5f;
+};
+
+/** Spawn the particle of the slot 'slot' of 'pool' at 'origin' following 'settings' **/
+inline void emit_particle(ParticlePool& pool, unsigned int slot, glm::vec3 origin, const EmitterSettings& settings, ParticleRandom& random){
+    float speed = random.uniform(settings.speed_min, settings.speed_max);
+    float shade = random.uniform(settings.shade_min, settings.shade_max);
+    glm::vec3 direction = settings.direction;
+    if (settings.mirror && (random.next() & 0x80000000u)) direction = glm::vec3(-direction.x, direction.y, -direction.z);
+    glm::vec3 velocity = direction * speed;
+    if (settings.spread != glm::vec3(0.0f))
+        velocity += settings.spread * glm::vec3(random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f));
+    pool.set(slot, origin + settings.offset, velocity, glm::vec4(shade, shade, shade, 1.0f), settings.lifetime);
+}
+
+/**
+ * @brief Draws the live particles of a pool as one instanced quad. The position and the color of each particle are
+ * interleaved into an instance buffer streamed every frame, in pool order with additive blending or back to front
+ * with alpha blending
 **/
-class ParticleGenerator{
+class ParticleBatch{
 public:
-    std::vector<Particle> particles;
-    unsigned int amount;
-    unsigned int VAO;
-    unsigned int texture;
-    unsigned int lastUsedParticle;
-    
-    Shader shader = Shader(PATH_TO_SHADER "/particle/particle.vs", PATH_TO_SHADER "/particle/particle.fs");
-    Spirit* spirit;
-    Camera* camera;
+    unsigned int VAO = 0;
+    unsigned int quadVBO = 0;
+    // live particles of the frame, interleaved before being streamed to the instance buffer
+    std::vector<ParticleInstance> instances;
+    unsigned int instanceVBO = 0;
+    unsigned int instanceCapacity = 0;
+    TextureHandle texture;
+    // order of the particles, sorted for the alpha-blended particles (smoke, dust)
+    ParticleSorter sorter;
 
-    /** Constructor **/
-    ParticleGenerator(unsigned int amount,Spirit* spirit,Camera* camera){
-        this->spirit = spirit;
-        this->amount = amount;
-        this->camera = camera;
-        texture = loadTexture(PATH_TO_TEXTURE "/round_particle.png",8);
-        
+    ShaderProgram shader = ShaderProgram(PATH_TO_SHADER "/particle/particle.vs", PATH_TO_SHADER "/particle/particle.fs");
+
+    ParticleBatch(){
+        TextureParams params;
+        params.flip = true;
+        texture = TextureCache::get().acquire(PATH_TO_TEXTURE "/round_particle.png", params);
         init();
     }
 
+    /** Draw the particles back to front with alpha blending, or in any order with additive blending (PARTICLES_UNSORTED) **/
+    void setSort(ParticleSort mode){
+        sorter.mode = mode;
+        sorter.invalidate();
+    }
 
-    /** Spawn the new particles and update the life and position of the particles **/
-    void Update(float dt, unsigned int newParticles,Object* object, glm::vec3 offset = glm::vec3(0.0f)){
-        // add new particles 
-        for (unsigned int i = 0; i < newParticles; ++i){
-            int unusedParticle = firstUnusedParticle();
-            respawnParticle(particles[unusedParticle],object, offset);
+    /**
+     * Stream the live particles of 'pool' to the instance buffer and draw them all with one draw call.
+     * The sorted modes need the 'camera', they're drawn unsorted without it
+    **/
+    void draw(const ParticlePool& pool, const Camera* camera = nullptr){
+        if (!texture->resident || pool.size() == 0) return;
+        instances.resize(pool.size());
+        if (sorter.mode != PARTICLES_UNSORTED && camera != nullptr) {
+            const std::vector<uint32_t>& order = sorter.sort(pool, camera->Position, camera->Front);
+            for (unsigned int i = 0; i < pool.size(); i++) instances[i] = {pool.position(order[i]), pool.color(order[i])};
         }
-        // update all particles
-        for (unsigned int i = 0; i < amount; ++i){
-            Particle &p = particles[i];
-            p.Life -= dt; // reduce life
-            if (p.Life > 0.0f)  {	// particle is alive, thus update
-                p.Position += p.Velocity * dt; 
-                p.Color.a -= dt * 2.5f;
-            }
+        else {
+            for (unsigned int i = 0; i < pool.size(); i++) instances[i] = {pool.position(i), pool.color(i)};
         }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // grow by doubling, and orphan the storage of the previous frame instead of waiting for the GPU to release it
+        while (instanceCapacity < instances.size()) instanceCapacity = instanceCapacity ? instanceCapacity * 2 : 256;
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(ParticleInstance), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        begin(shader);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)instances.size());
+        glBindVertexArray(0);
+        end();
     }
 
-    /** Bind your vertex arrays and call glDrawArrays and setup the MVP matrix **/
-    void draw(){
-        //use additive blending to give it a 'glow' effect
+    /** Use 'program' with the sprite and the blending of the particles **/
+    void begin(ShaderProgram program){
         glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        shader.use();
-        glActiveTexture(GL_TEXTURE8);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        shader.setInteger("sprite",8);
-        shader.setMatrix4("projection",camera->GetProjectionMatrix());
-        shader.setMatrix4("view",camera->GetViewMatrix());
-
-        for (Particle particle : particles)
-        {
-            if (particle.Life > 0.0f){
-                shader.setVector3f("offset", particle.Position);
-                shader.setVector4f("color", particle.Color);
-                glBindVertexArray(VAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                glBindVertexArray(0);
-            }
+        if (sorter.mode == PARTICLES_UNSORTED) {
+            //use additive blending to give it a 'glow' effect
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        }
+        else {
+            // the sorted particles cover each other, they're tested against the scene but don't hide the ones behind
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
         }
+        program.use();
+        texture->bind(UNIT_PARTICLE);
+        program.setInteger("sprite",UNIT_PARTICLE);
+    }
+
+    void end(){
         //Reset to default blending mode
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_TRUE);
     }
 
+private:
     /** Create the vertex, texture coordinate for the particle and link them to the buffer **/
     void init(){
         // set up mesh and attribute properties
-        unsigned int VBO;
         float particle_quad[] = {
             0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
             1.0f, 0.0f, 0.0f,1.0f, 0.0f,
@@ -111,10 +167,10 @@ public:
         }; 
 
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &quadVBO);
         glBindVertexArray(VAO);
         // fill mesh buffer
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
         // set mesh attributes
         auto att_pos = glGetAttribLocation(shader.ID, "position");
@@ -123,90 +179,205 @@ public:
         auto att_tex = glGetAttribLocation(shader.ID, "tex_coord");
         glEnableVertexAttribArray(att_tex);
         glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+        // position and color of each particle, advancing once per instance
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        auto att_offset = glGetAttribLocation(shader.ID, "offset");
+        glEnableVertexAttribArray(att_offset);
+        glVertexAttribPointer(att_offset, 3, GL_FLOAT, false, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, position));
+        glVertexAttribDivisor(att_offset, 1);
+        auto att_color = glGetAttribLocation(shader.ID, "color");
+        if (att_color >= 0) {
+            glEnableVertexAttribArray(att_color);
+            glVertexAttribPointer(att_color, 4, GL_FLOAT, false, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, color));
+            glVertexAttribDivisor(att_color, 1);
+        }
 		
         //desactive the buffer
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindVertexArray(0);
-
-         // create this->amount default particle instances
-        for (unsigned int i = 0; i < this->amount; ++i)
-            this->particles.push_back(Particle());
     }
+};
 
-    /** Find the first unused particle in the array of particle **/
-    unsigned int firstUnusedParticle(){
-        // first search from last used particle, this will usually return almost instantly
-        for (unsigned int i = lastUsedParticle; i < amount; ++i){
-            if (particles[i].Life <= 0.0f){
-                lastUsedParticle = i;
-                return i;
-            }
-        }
-        // otherwise, do a linear search
-        for (unsigned int i = 0; i < lastUsedParticle; ++i){
-            if (particles[i].Life <= 0.0f){
-                lastUsedParticle = i;
-                return i;
-            }
+/** Where the particles are updated : walked by the CPU every frame, or kept on the GPU and updated by transform feedback **/
+enum ParticleBackend {
+    PARTICLES_CPU,
+    PARTICLES_GPU
+};
+
+/**
+ * @brief Particles living in two buffers on the GPU. Each update is a transform feedback pass reading one buffer and
+ * writing the spawned and integrated particles into the other, the CPU only sends the emitter parameters. The new
+ * particles take the next slots of a ring, which are the oldest ones since every particle lives as long
+**/
+class GpuParticles{
+public:
+    GpuParticles(unsigned int amount, GLuint quadVBO, ShaderProgram drawShader) : amount(amount), draw_shader(drawShader),
+        update_shader(ShaderProgram::feedback(PATH_TO_SHADER "/particle/particle_update.vs",
+                                              {"out_position", "out_velocity", "out_color", "out_life"}))
+    {
+        // every slot starts dead, the particles only appear once spawned
+        std::vector<Particle> initial(amount);
+        for (Particle& particle : initial) particle.Life = 0.0f;
+        glGenBuffers(2, buffers);
+        glGenVertexArrays(2, update_vao);
+        glGenVertexArrays(2, draw_vao);
+        for (int i = 0; i < 2; i++){
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, amount * sizeof(Particle), initial.data(), GL_DYNAMIC_COPY);
+
+            // read by the update pass, one particle per vertex
+            glBindVertexArray(update_vao[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            attribute(update_shader.ID, "position", 3, offsetof(Particle, Position), 0);
+            attribute(update_shader.ID, "velocity", 3, offsetof(Particle, Velocity), 0);
+            attribute(update_shader.ID, "color", 4, offsetof(Particle, Color), 0);
+            attribute(update_shader.ID, "life", 1, offsetof(Particle, Life), 0);
+
+            // read by the draw, the quad per vertex and the particle per instance
+            glBindVertexArray(draw_vao[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+            auto att_pos = glGetAttribLocation(draw_shader.ID, "position");
+            glEnableVertexAttribArray(att_pos);
+            glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 5 * sizeof(float), (void*)0);
+            auto att_tex = glGetAttribLocation(draw_shader.ID, "tex_coord");
+            glEnableVertexAttribArray(att_tex);
+            glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            attribute(draw_shader.ID, "offset", 3, offsetof(Particle, Position), 1);
+            attribute(draw_shader.ID, "color", 4, offsetof(Particle, Color), 1);
+            attribute(draw_shader.ID, "life", 1, offsetof(Particle, Life), 1);
         }
-        // all particles are taken, override the first one (note that if it repeatedly hits this case, more particles should be reserved)
-        lastUsedParticle = 0;
-        return 0;
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /** Respawn 'spawn' particles at 'origin' following 'settings' and move every particle by 'dt', without reading anything back **/
+    void update(float dt, unsigned int spawn, glm::vec3 origin, const EmitterSettings& settings){
+        spawn = std::min(spawn, amount);
+        update_shader.use();
+        update_shader.setFloat("dt", dt);
+        update_shader.setInteger("amount", (int)amount);
+        update_shader.setInteger("spawn_start", (int)next_spawn);
+        update_shader.setInteger("spawn_count", (int)spawn);
+        update_shader.setVector3f("spawn_origin", origin);
+        update_shader.setInteger("seed", (int)(++updates * 2654435761u));
+        update_shader.setVector3f("spawn_direction", settings.direction);
+        update_shader.setInteger("spawn_mirror", settings.mirror ? 1 : 0);
+        update_shader.setFloat("speed_min", settings.speed_min);
+        update_shader.setFloat("speed_max", settings.speed_max);
+        update_shader.setVector3f("spawn_spread", settings.spread);
+        update_shader.setFloat("spawn_lifetime", settings.lifetime);
+        update_shader.setFloat("shade_min", settings.shade_min);
+        update_shader.setFloat("shade_max", settings.shade_max);
+        next_spawn = (next_spawn + spawn) % amount;
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(update_vao[current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, amount);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        current = 1 - current;
+    }
+
+    /** Draw every particle as an instanced quad with the program of drawShader(), which must be in use **/
+    void draw(){
+        glBindVertexArray(draw_vao[current]);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, amount);
+        glBindVertexArray(0);
+    }
+
+    ShaderProgram drawShader() const {
+        return draw_shader;
+    }
+
+private:
+    /** Read the float field at 'offset' of each Particle of the buffer bound to GL_ARRAY_BUFFER **/
+    static void attribute(GLuint program, const char* name, GLint size, size_t offset, GLuint divisor){
+        GLint location = glGetAttribLocation(program, name);
+        // the outputs that aren't used by the next stage are removed by the linker
+        if (location < 0) return;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, GL_FLOAT, false, sizeof(Particle), (void*)offset);
+        glVertexAttribDivisor(location, divisor);
     }
 
-    /** Respawn a particle by setting it's life, position and velocity **/
-    void respawnParticle(Particle &particle,Object* object, glm::vec3 offset = glm::vec3(0.0)){
-        float random = ((rand() % 100) - 50) / 20.0f;
-        float rColor = 0.5f + ((rand() % 100) / 100.0f);
-        particle.Position = object->transform.getWorldTranslation()+glm::vec3(-0.5,2,0);
-        particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
-        particle.Life = 3.0f;
-        if (rand() % 100 < 50){
-            particle.Velocity = glm::vec3(0.2,0.4,-0.2) * random ;
+    unsigned int amount;
+    ShaderProgram draw_shader;
+    ShaderProgram update_shader;
+    GLuint buffers[2], update_vao[2], draw_vao[2];
+    // buffer holding the particles of the last update
+    int current = 0;
+    unsigned int next_spawn = 0;
+    unsigned int updates = 0;
+};
+
+/** @brief ParticleGenerator acts as a container for rendering a large number of 
+ * particles by repeatedly spawning and updating particles and killing 
+ * them after a given amount of time.
+**/
+class ParticleGenerator{
+public:
+    // live particles of the CPU backend, kept compacted at the front of the arrays
+    ParticlePool pool;
+    ParticleRandom random;
+    EmitterSettings settings;
+    unsigned int amount;
+    ParticleBatch batch;
+    // set for the GPU backend, the pool then stays empty
+    std::shared_ptr<GpuParticles> gpu;
+    Spirit* spirit;
+    Camera* camera;
+
+    /** Constructor **/
+    ParticleGenerator(unsigned int amount,Spirit* spirit,Camera* camera, ParticleBackend backend = PARTICLES_CPU){
+        this->spirit = spirit;
+        this->amount = amount;
+        this->camera = camera;
+        if (backend == PARTICLES_GPU)
+            gpu = std::make_shared<GpuParticles>(amount, batch.quadVBO, batch.shader.variant({{"PARTICLE_LIFE", "1"}}));
+        else
+            pool.reserve(amount);
+    }
+
+
+    /** Spawn the new particles and update the life and position of the particles **/
+    void Update(float dt, unsigned int newParticles,Object* object, glm::vec3 offset = glm::vec3(0.0f)){
+        if (gpu) {
+            gpu->update(dt, newParticles, object->transform.getWorldTranslation()+settings.offset, settings);
+            return;
         }
-        else{ 
-            // particle.Position = spirit->getObject()->transform.getWorldTranslation() - random +glm::vec3(-0.5,2,0);
-            particle.Velocity = glm::vec3(-0.2,0.4,0.2) * random ;
+        // add new particles 
+        for (unsigned int i = 0; i < newParticles; ++i){
+            int slot = pool.spawn();
+            if (slot >= 0) emit_particle(pool, (unsigned int)slot, object->transform.getWorldTranslation(), settings, random);
         }
+        // move and fade the live particles, the dead ones are removed
+        pool.update(dt);
     }
 
-    /** Load the texture into the 'texture_nb' channel with the appropriate parameters **/
-    unsigned int loadTexture(char const * path, int texture_nb){
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glActiveTexture(GL_TEXTURE0+texture_nb);
-
-        int width, height, nrComponents;
-        unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-        if (data)
-        {
-            GLenum format;
-            if (nrComponents == 1)
-                format = GL_RED;
-            else if (nrComponents == 3)
-                format = GL_RGB;
-            else if (nrComponents == 4)
-                format = GL_RGBA;
-
-            glActiveTexture(GL_TEXTURE0+texture_nb);
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Texture failed to load at path: " << path << std::endl;
-            stbi_image_free(data);
+    /** Sort the particles back to front for alpha blending, only the CPU backend can be sorted **/
+    void setSort(ParticleSort mode){
+        batch.setSort(gpu ? PARTICLES_UNSORTED : mode);
+    }
+
+    /** Draw every live particle with one instanced quad **/
+    void draw(){
+        if (!gpu) {
+            batch.draw(pool, camera);
+            return;
         }
-        return textureID;
+        if (!batch.texture->resident) return;
+        batch.begin(gpu->drawShader());
+        gpu->draw();
+        batch.end();
     }
 };
 
-#endif
\ No newline at end of file
+#endif
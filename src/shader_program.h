@@ -0,0 +1,324 @@
+/**
+* @brief This header file defines the ShaderProgram class, a program made of any combination of vertex, tessellation,
+* geometry and fragment shaders. The sources are preprocessed (#include and #define) before being compiled
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+
+#include "./utils/uniform_table.h"
+#include "./uniform_blocks.h"
+#include "./utils/program_cache.h"
+
+// nested #include deeper than this are considered as a loop
+const int SHADER_INCLUDE_DEPTH = 16;
+
+/** Compile-time options of a program, each one becomes '#define NAME VALUE' after the #version of every stage **/
+typedef std::map<std::string, std::string> ShaderDefines;
+
+/**
+ * @brief What a program is built from : the file of each stage, the defines of the permutation and the outputs
+ * captured by transform feedback
+**/
+struct ShaderSource {
+    std::vector<std::pair<GLenum, std::string>> paths;
+    ShaderDefines defines;
+    std::vector<std::string> feedback;
+
+    /** Name of the permutation in the registry of the programs **/
+    std::string key() const {
+        std::string key;
+        for (const auto& path : paths) key += std::to_string(path.first) + ":" + path.second + "\n";
+        for (const auto& define : defines) key += define.first + "=" + define.second + "\n";
+        for (const auto& varying : feedback) key += "feedback:" + varying + "\n";
+        return key;
+    }
+};
+
+/**
+ * @brief Class that handle the shaders of a pipeline. Every permutation (stages and defines) is compiled once :
+ * a second program with the same permutation shares the first one, and the linked program is kept on disk
+ * by the ProgramCache for the next launches
+**/
+class ShaderProgram{
+public:
+    GLuint ID = 0;
+    // active uniforms of the program, shared by the copies of the shader
+    std::shared_ptr<UniformTable> uniforms;
+
+    /** Constructor, the stages given as nullptr are not part of the program **/
+    ShaderProgram(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+                  const char* tessControlPath = nullptr, const char* tessEvalPath = nullptr,
+                  const ShaderDefines& defines = ShaderDefines())
+    {
+        auto source = std::make_shared<ShaderSource>();
+        std::pair<GLenum, const char*> stages[] = {{GL_VERTEX_SHADER, vertexPath}, {GL_TESS_CONTROL_SHADER, tessControlPath},
+            {GL_TESS_EVALUATION_SHADER, tessEvalPath}, {GL_GEOMETRY_SHADER, geometryPath}, {GL_FRAGMENT_SHADER, fragmentPath}};
+        for (const auto& stage : stages)
+            if (stage.second != nullptr) source->paths.push_back(std::make_pair(stage.first, std::string(stage.second)));
+        source->defines = defines;
+        bool created;
+        *this = acquire(source, created);
+    }
+
+    /**
+     * Program made of the vertex shader 'vertexPath' alone, its outputs 'varyings' are written interleaved
+     * to the buffer bound to GL_TRANSFORM_FEEDBACK_BUFFER. It's drawn with GL_RASTERIZER_DISCARD enabled
+    **/
+    static ShaderProgram feedback(const char* vertexPath, const std::vector<std::string>& varyings,
+                                  const ShaderDefines& defines = ShaderDefines())
+    {
+        auto source = std::make_shared<ShaderSource>();
+        source->paths.push_back(std::make_pair((GLenum)GL_VERTEX_SHADER, std::string(vertexPath)));
+        source->defines = defines;
+        source->feedback = varyings;
+        bool created;
+        return acquire(source, created);
+    }
+
+    /**
+     * Permutation of this program with 'defines' added to (or replacing) its own. A new permutation is compiled
+     * on the first call and starts with the uniform values known by this program, later changes aren't shared
+    **/
+    ShaderProgram variant(const ShaderDefines& defines) const
+    {
+        auto permutation = std::make_shared<ShaderSource>(*source);
+        for (const auto& define : defines) permutation->defines[define.first] = define.second;
+        bool created;
+        ShaderProgram program = acquire(permutation, created);
+        if (created)
+        {
+            GLint current = 0;
+            glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+            glUseProgram(program.ID);
+            program.uniforms->copy_values(*uniforms);
+            glUseProgram(current);
+        }
+        return program;
+    }
+
+    /** Activate the shader **/
+    void use() {
+        glUseProgram(ID);
+    }
+
+    /** Resolve the uniform 'name' once, for the code setting it every frame **/
+    template<typename T>
+    UniformHandle<T> uniform(const GLchar* name) const {
+        return UniformHandle<T>(uniforms.get(), uniforms->find(name));
+    }
+
+    void setBool(const GLchar* name, bool value) const {
+        uniforms->set(uniforms->find(name), (int)value);
+    }
+    void setInteger(const GLchar* name, GLint value) const {
+        uniforms->set(uniforms->find(name), (int)value);
+    }
+    void setFloat(const GLchar* name, GLfloat value) const {
+        uniforms->set(uniforms->find(name), (float)value);
+    }
+    void setVector2f(const GLchar* name, const glm::vec2& value) const {
+        uniforms->set(uniforms->find(name), value);
+    }
+    void setVector3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z) const {
+        uniforms->set(uniforms->find(name), glm::vec3(x, y, z));
+    }
+    void setVector3f(const GLchar* name, const glm::vec3& value) const {
+        uniforms->set(uniforms->find(name), value);
+    }
+    void setVector4f(const GLchar* name, const glm::vec4& value) const {
+        uniforms->set(uniforms->find(name), value);
+    }
+    void setMatrix2(const GLchar* name, const glm::mat2& matrix) const {
+        uniforms->set(uniforms->find(name), matrix);
+    }
+    void setMatrix3(const GLchar* name, const glm::mat3& matrix) const {
+        uniforms->set(uniforms->find(name), matrix);
+    }
+    void setMatrix4(const GLchar* name, const glm::mat4& matrix) const {
+        uniforms->set(uniforms->find(name), matrix);
+    }
+
+private:
+    std::shared_ptr<const ShaderSource> source;
+
+    ShaderProgram() {}
+
+    /** Programs already built, by permutation **/
+    static std::unordered_map<std::string, ShaderProgram>& registry() {
+        static std::unordered_map<std::string, ShaderProgram> programs;
+        return programs;
+    }
+
+    /** Program of the permutation 'source', 'created' tells if it was built by this call **/
+    static ShaderProgram acquire(const std::shared_ptr<const ShaderSource>& source, bool& created)
+    {
+        std::string key = source->key();
+        auto found = registry().find(key);
+        created = found == registry().end();
+        if (!created) return found->second;
+
+        ShaderProgram program;
+        program.source = source;
+        program.build();
+        registry().emplace(key, program);
+        return program;
+    }
+
+    /** Load the program from the program cache, or compile it and put it in the cache **/
+    void build()
+    {
+        std::vector<std::pair<GLenum, std::string>> stages;
+        for (const auto& path : source->paths)
+            stages.push_back(std::make_pair(path.first, preprocess(path.second, source->defines)));
+        // the captured outputs are part of the linked program, and of its key in the cache
+        std::string varyings;
+        for (const auto& varying : source->feedback) varyings += varying + "\n";
+        std::vector<std::pair<GLenum, std::string>> keyed = stages;
+        if (!varyings.empty()) keyed.push_back(std::make_pair((GLenum)GL_TRANSFORM_FEEDBACK_VARYINGS, varyings));
+
+        ProgramCache& cache = ProgramCache::get();
+        uint64_t key = cache.key(keyed);
+        ID = cache.load(key);
+        if (!ID)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<GLuint> shaders;
+            for (const auto& stage : stages) shaders.push_back(compileShader(stage.second, stage.first));
+            ID = compileProgram(shaders, source->feedback);
+            // the shaders are linked into the program now and no longer necessary
+            for (GLuint shader : shaders) glDeleteShader(shader);
+            cache.store(key, ID, ProgramCache::elapsed_ms(start));
+        }
+        uniforms = std::make_shared<UniformTable>(ID);
+        bind_uniform_blocks(ID);
+    }
+
+    /** Code of the file 'path' with its #include resolved and the 'defines' written after its #version **/
+    static std::string preprocess(const std::string& path, const ShaderDefines& defines)
+    {
+        std::string code;
+        std::vector<std::string> included;
+        include(path, code, included, 0);
+
+        std::string lines;
+        for (const auto& define : defines) lines += "#define " + define.first + " " + define.second + "\n";
+        // the #version has to stay the first line of the shader
+        size_t version = code.find("#version");
+        size_t position = version == std::string::npos ? 0 : code.find('\n', version);
+        position = position == std::string::npos ? code.size() : position + 1;
+        code.insert(position, lines);
+        return code;
+    }
+
+    /** Append the lines of 'path' to 'code', the #include "file" are relative to the file and included only once **/
+    static bool include(const std::string& path, std::string& code, std::vector<std::string>& included, int depth)
+    {
+        if (depth > SHADER_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << path << std::endl;
+            return false;
+        }
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        included.push_back(path);
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                code += line + "\n";
+                continue;
+            }
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE in " << path << ": " << line << std::endl;
+                continue;
+            }
+            std::string target = directory + line.substr(open + 1, close - open - 1);
+            bool done = false;
+            for (const auto& name : included) done = done || name == target;
+            if (!done) include(target, code, included, depth + 1);
+        }
+        return true;
+    }
+
+    /** Compile the shader into readable format for OpenGL**/
+    static GLuint compileShader(const std::string& shaderCode, GLenum shaderType)
+    {
+        GLuint shader = glCreateShader(shaderType);
+        const char* code = shaderCode.c_str();
+        glShaderSource(shader, 1, &code, NULL);
+        glCompileShader(shader);
+
+        GLchar infoLog[1024];
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            std::string t = "undetermined";
+            switch (shaderType) {
+            case GL_VERTEX_SHADER: t = "vertex shader"; break;
+            case GL_TESS_CONTROL_SHADER: t = "tessellation control shader"; break;
+            case GL_TESS_EVALUATION_SHADER: t = "tessellation evaluation shader"; break;
+            case GL_GEOMETRY_SHADER: t = "geometry shader"; break;
+            case GL_FRAGMENT_SHADER: t = "fragment shader"; break;
+            }
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR of the " << t << ": " << infoLog << std::endl;
+        }
+        return shader;
+    }
+
+    /** Compile the program and link the shaders to it**/
+    static GLuint compileProgram(const std::vector<GLuint>& shaders, const std::vector<std::string>& feedback)
+    {
+        GLuint programID = glCreateProgram();
+        for (GLuint shader : shaders) glAttachShader(programID, shader);
+        if (!feedback.empty())
+        {
+            std::vector<const GLchar*> names;
+            for (const auto& varying : feedback) names.push_back(varying.c_str());
+            glTransformFeedbackVaryings(programID, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+        }
+        ProgramCache::get().prepare(programID);
+        glLinkProgram(programID);
+
+        GLchar infoLog[1024];
+        GLint success;
+        glGetProgramiv(programID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(programID, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR:  " << infoLog << std::endl;
+        }
+        return programID;
+    }
+};
+#endif
@@ -17,12 +17,8 @@ out vec4 frag_pos_lightspace;
 
 
 uniform mat4 M; 
-uniform mat4 V; 
-uniform mat4 P; 
-
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform mat4 lightspace; 
+#include "../include/frame.glsl"
+#include "../include/lights.glsl"
 
 void main()
 {
@@ -37,8 +33,8 @@ void main()
     vec3 B = cross(N, T);
     
     mat3 TBN = transpose(mat3(T, B, N));    
-    TangentLightPos = TBN * lightPos;
-    TangentViewPos  = TBN * viewPos;
+    TangentLightPos = TBN * light_pos;
+    TangentViewPos  = TBN * u_view_pos;
     TangentFragPos  = TBN * FragPos;
         
     gl_Position = P*V*M*vec4(aPos, 1.0);
@@ -6,8 +6,7 @@ in vec3 normal;
 
 out vec2 TexCoords;
 uniform mat4 M;
-uniform mat4 V;
-uniform mat4 P;
+#include "../include/frame.glsl"
 
 void main()
 {
@@ -1,10 +1,10 @@
 #version 330 core
 in vec3 position;
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 M;
+#include "../include/frame.glsl"
+#include "../include/vertex.glsl"
 
 void main()
 {
-    gl_Position = lightSpaceMatrix* M * vec4(position, 1.0);
+    gl_Position = lightspace * model_matrix() * vec4(dequantize_position(position), 1.0);
 }
\ No newline at end of file
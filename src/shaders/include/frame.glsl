@@ -0,0 +1,8 @@
+// camera and shadow matrix of the frame, shared by every shader
+layout(std140) uniform FrameData {
+    mat4 V;
+    mat4 P;
+    mat4 lightspace;
+    vec3 u_view_pos;
+    float time;
+};
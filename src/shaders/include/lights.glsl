@@ -0,0 +1,22 @@
+// lights of the scene, shared by every shader
+layout(std140) uniform LightData {
+    vec3 light_pos;
+    vec3 light_dir;
+};
+
+// strengths of the point light, set by each material
+struct Light{
+    float ambient_strength;
+    float diffuse_strength;
+    float specular_strength;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// strengths of the directional light, set by each material
+struct DirLight{
+    float ambient;
+    float diffuse;
+    float specular;
+};
@@ -0,0 +1,38 @@
+// COMPACT_VERTEX 1 for the meshes in the compact vertex format, their position is dequantized with the uniforms
+// set by Object::draw(shader). The programs drawing compact meshes opt in, the float meshes keep the default
+#ifndef COMPACT_VERTEX
+#define COMPACT_VERTEX 0
+#endif
+
+#if COMPACT_VERTEX
+uniform vec3 u_pos_scale;
+uniform vec3 u_pos_offset;
+
+vec3 dequantize_position(vec3 position){
+    return position * u_pos_scale + u_pos_offset;
+}
+#else
+vec3 dequantize_position(vec3 position){
+    return position;
+}
+#endif
+
+// INSTANCED 1 for the batches drawing a mesh many times in one call, the model matrix of each copy is the
+// per-instance attribute instance_model instead of the uniform M
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+
+#if INSTANCED
+in mat4 instance_model;
+
+mat4 model_matrix(){
+    return instance_model;
+}
+#else
+uniform mat4 M;
+
+mat4 model_matrix(){
+    return M;
+}
+#endif
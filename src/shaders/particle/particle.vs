@@ -8,15 +8,27 @@ in vec3 position;
 out vec2 TexCoords;
 out vec4 ParticleColor;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform vec3 offset;
-uniform vec4 color;
+// position and color of the particle, one per instance
+in vec3 offset;
+in vec4 color;
+
+// PARTICLE_LIFE 1 when the particles stay on the GPU : every particle is drawn and the dead ones are moved out of the clip volume
+#ifndef PARTICLE_LIFE
+#define PARTICLE_LIFE 0
+#endif
+#if PARTICLE_LIFE
+in float life;
+#endif
+
+#include "../include/frame.glsl"
 
 void main()
 {
     vec4 frag_pos = vec4(position+ offset,1.0);
     TexCoords = tex_coord;
     ParticleColor = color;
-    gl_Position = projection * view * frag_pos;
+    gl_Position = P * V * frag_pos;
+#if PARTICLE_LIFE
+    if (life <= 0.0) gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+#endif
 }
\ No newline at end of file
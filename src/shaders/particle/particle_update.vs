@@ -0,0 +1,73 @@
+#version 330 core
+
+// state of the particle, the layout of the Particle struct
+in vec3 position;
+in vec3 velocity;
+in vec4 color;
+in float life;
+
+// new state, captured by transform feedback into the other buffer
+out vec3 out_position;
+out vec3 out_velocity;
+out vec4 out_color;
+out float out_life;
+
+uniform float dt;
+uniform int amount;
+// the particles [spawn_start, spawn_start + spawn_count) of the ring are respawned at spawn_origin
+uniform int spawn_start;
+uniform int spawn_count;
+uniform vec3 spawn_origin;
+uniform int seed;
+// emitter of the new particles, the fields of EmitterSettings
+uniform vec3 spawn_direction;
+uniform int spawn_mirror;
+uniform float speed_min;
+uniform float speed_max;
+uniform vec3 spawn_spread;
+uniform float spawn_lifetime;
+uniform float shade_min;
+uniform float shade_max;
+
+uint hash(uint x){
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// random value in [0, 1)
+float random(inout uint state){
+    state = hash(state);
+    return float(state & 0xffffffu) / 16777216.0;
+}
+
+void main()
+{
+    out_position = position;
+    out_velocity = velocity;
+    out_color = color;
+    out_life = life;
+
+    // the same distribution as emit_particle on the CPU
+    if ((gl_VertexID - spawn_start + amount) % amount < spawn_count){
+        uint state = uint(seed) ^ (uint(gl_VertexID) * 9781u);
+        float speed = mix(speed_min, speed_max, random(state));
+        float shade = mix(shade_min, shade_max, random(state));
+        vec3 direction = spawn_direction;
+        if (spawn_mirror != 0 && random(state) < 0.5) direction = vec3(-direction.x, direction.y, -direction.z);
+        vec3 spread = vec3(random(state), random(state), random(state)) * 2.0 - 1.0;
+        out_position = spawn_origin;
+        out_velocity = direction * speed + spawn_spread * spread;
+        out_color = vec4(shade, shade, shade, 1.0);
+        out_life = spawn_lifetime;
+    }
+
+    out_life -= dt;
+    if (out_life > 0.0){
+        out_position += out_velocity * dt;
+        out_color.a -= dt * 2.5;
+    }
+}
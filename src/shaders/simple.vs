@@ -8,16 +8,22 @@ out vec3 v_frag_coord;
 out vec3 v_normal; 
 out vec4 frag_pos_lightspace;
 
-uniform mat4 M; 
+#include "include/frame.glsl"
+#include "include/vertex.glsl"
+#if !INSTANCED
 uniform mat4 itM; 
-uniform mat4 V; 
-uniform mat4 P;
-uniform mat4 lightspace; 
+#endif
 
 void main(){ 
-    vec4 frag_coord = M*vec4(position, 1.0); 
+    mat4 model = model_matrix();
+    vec4 frag_coord = model*vec4(dequantize_position(position), 1.0); 
     gl_Position = P*V*frag_coord; 
+#if INSTANCED
+    // the instances are only rotated and uniformly scaled, their model matrix also transforms the normals
+    v_normal = mat3(model) * normal;
+#else
     v_normal = vec3(itM * vec4(normal, 1.0)); 
+#endif
     v_frag_coord = frag_coord.xyz; 
     frag_pos_lightspace = lightspace * frag_coord;
 };  
\ No newline at end of file
@@ -5,8 +5,7 @@ in vec2 tex_coords;
 in vec3 normal; 
 
 //only P and V are necessary
-uniform mat4 V; 
-uniform mat4 P; 
+#include "../include/frame.glsl"
 
 out vec3 texCoord_v; 
 
@@ -3,18 +3,18 @@
 out vec4 FragColor;
 
 in float Height;
+in vec2 v_tex_coord;
+#if TILED
 in vec3 v_normal;
+#else
+uniform sampler2D normalMap;  // unit normal * 0.5 + 0.5 baked from the height map, the slope in alpha
+#endif
 in vec3 v_frag_coord;
 
-struct DirLight{
-    vec3 direction;
-    float ambient;
-    float diffuse;
-    float specular;
-};
+#include "../include/frame.glsl"
+#include "../include/lights.glsl"
 
 uniform DirLight dir_light;
-uniform vec3 u_view_pos;
 
 void main()
 {
@@ -47,14 +47,16 @@ void main()
         color = vec3(gradient*white + (1.0 - gradient) * white);
     }
 
-    //Compute normals
-    vec3 x = dFdx(v_frag_coord); // "FragPos = vec3(model * p);" from the tess eval
-    vec3 y = dFdy(v_frag_coord);
-    vec3 normal = inverse(mat3(mat4(1.0))) * normalize(cross(x, y));
-    
+    //Normal of the height map, the same for every view
+#if TILED
+    vec3 normal = v_normal;
+#else
+    vec3 normal = texture(normalMap, v_tex_coord).xyz * 2.0 - 1.0;
+#endif
+
     //Directional light
     vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(dir_light.direction);  
+    vec3 lightDir = normalize(light_dir);  
     float diff = max(dot(norm, lightDir), 0.0);
     float dir_diffuse = dir_light.diffuse * diff;  
     vec3 viewDir = normalize(u_view_pos - v_frag_coord);
@@ -63,5 +65,5 @@ void main()
     float dir_specular = dir_light.specular * spec ;  
     float dir_light = dir_light.ambient +  (dir_diffuse + dir_specular);
 
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(color * dir_light, 1.0);
 }
\ No newline at end of file
@@ -1,11 +1,36 @@
 #version 410 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTex;
+// one instance per patch of the quadtree, the 4 control points are the corners of the patch
+layout (location = 0) in vec3 aPatch;    // corner and size of the patch in texture coordinates
+layout (location = 1) in vec2 aHeights;  // lowest and highest world height of the displaced patch
+#if TILED
+layout (location = 2) in vec4 aTile;     // layer of the tile, world corner (x, z) and world size of the tile
+#else
+layout (location = 2) in vec4 aEdges;    // tessellation of the edges (-x, -z, +x, +z) relative to the interior
+#endif
+
+uniform vec2 terrain_size;
+uniform float terrain_base;
 
 out vec2 TexCoord;
+out vec2 Heights;
+#if TILED
+out vec4 Tile;
+#else
+out vec4 Edges;
+#endif
 
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
-    TexCoord = aTex;
-}
\ No newline at end of file
+    // corners in the order 00, 01, 10, 11 : x then z
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    TexCoord = aPatch.xy + corner * aPatch.z;
+#if TILED
+    // the coordinates are the ones of the tile
+    gl_Position = vec4(aTile.y + TexCoord.x * aTile.w, terrain_base, aTile.z + TexCoord.y * aTile.w, 1.0);
+    Tile = aTile;
+#else
+    gl_Position = vec4((TexCoord.x - 0.5) * terrain_size.x, terrain_base, (TexCoord.y - 0.5) * terrain_size.y, 1.0);
+    Edges = aEdges;
+#endif
+    Heights = aHeights;
+}
@@ -8,27 +8,12 @@ out vec4 FragColor;
 
 uniform sampler2D my_texture; 
 
-struct Light{
-    vec3 light_pos;
-    float ambient_strength;
-    float diffuse_strength;
-    float specular_strength;
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct DirLight{
-    vec3 direction;
-    float ambient;
-    float diffuse;
-    float specular;
-};
+#include "../include/frame.glsl"
+#include "../include/lights.glsl"
 
 uniform Light light;
 uniform DirLight dir_light;
 
-uniform vec3 u_view_pos;
 uniform float shininess;
 uniform vec3 materialColour;
 
@@ -41,19 +26,19 @@ float specularCalculation(vec3 N, vec3 L, vec3 V ){
 
 void main() {
     vec3 N = normalize(v_normal);
-    vec3 L = normalize(light.light_pos - v_frag_coord);
+    vec3 L = normalize(light_pos - v_frag_coord);
     vec3 V = normalize(u_view_pos - v_frag_coord);
     
     //SpotLight
     float specular = specularCalculation( N, L, V);
     float diffuse = light.diffuse_strength * max(dot(N,L),0.0);
-    float distance = length(light.light_pos - v_frag_coord);
+    float distance = length(light_pos - v_frag_coord);
     float attenuation = pow((light.constant + light.linear * distance + light.quadratic * distance * distance),-1);
     float light = light.ambient_strength +  attenuation * (diffuse + specular);
     
     //Directional light
     vec3 norm = normalize(v_normal);
-    vec3 lightDir = normalize(dir_light.direction);  
+    vec3 lightDir = normalize(light_dir);  
     float diff = max(dot(norm, lightDir), 0.0);
     float dir_diffuse = dir_light.diffuse * diff;  
     vec3 viewDir = normalize(u_view_pos - v_frag_coord);
@@ -9,8 +9,7 @@ out vec3 v_normal;
 out vec3 v_frag_coord;
 
 uniform mat4 M;
-uniform mat4 V;
-uniform mat4 P;
+#include "../include/frame.glsl"
 uniform mat4 itM;
 
 void main(){ 
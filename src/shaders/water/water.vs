@@ -7,11 +7,9 @@ in vec3 normal;
 out vec3 v_frag_coord; 
 out vec3 v_normal; 
 
-uniform mat4 M; 
 uniform mat4 itM; 
-uniform mat4 V; 
-uniform mat4 P; 
-uniform float time;
+#include "../include/frame.glsl"
+#include "../include/vertex.glsl"
 
 struct Wave{
     vec2 dir;
@@ -36,6 +34,7 @@ vec3 gerstner_wave(in Wave wave,vec3 position, inout vec3 tangent, inout vec3 bi
 
 void main(){ 
     Wave wave;
+    vec3 position = dequantize_position(position);
     vec3 p = position;
     vec3 tangent = vec3(0.0);
     vec3 binormal = vec3(0.0);
@@ -58,7 +57,7 @@ void main(){
     wave.wavelength = 9;
     p += gerstner_wave(wave,position,tangent,binormal);
 
-    vec4 frag_coord = M*vec4(p, 1.0); 
+    vec4 frag_coord = model_matrix()*vec4(p, 1.0); 
     gl_Position = P*V*frag_coord; 
     v_frag_coord = frag_coord.xyz;
 
@@ -12,8 +12,9 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
-#include "./simple_shader.h"
+#include "./shader_program.h"
 #include "./object.h"
+#include "./texture_cache.h"
 
 /**
 * @brief Class that handle a 3D spirit object with textures and physics
@@ -21,9 +22,9 @@
 class Spirit{
 public:
     Object* spirit;
-    Shader shader = Shader(PATH_TO_SHADER "/texture/simple_texture.vs", PATH_TO_SHADER "/texture/simple_texture.fs");
+    ShaderProgram shader = ShaderProgram(PATH_TO_SHADER "/texture/simple_texture.vs", PATH_TO_SHADER "/texture/simple_texture.fs");
     btRigidBody* rigid_body;
-    unsigned int spirit_texture;
+    TextureHandle spirit_texture;
 
     /** Constructor **/
     Spirit(glm::vec3 translation){
@@ -34,7 +35,12 @@ public:
         spirit->transform.updateModelMatrix();
         
         // Load the texture 
-        spirit_texture = loadTexture(PATH_TO_TEXTURE "/spirit_uv.jpg",1);
+        TextureParams params;
+        params.wrap = GL_REPEAT;
+        params.min_filter = GL_NEAREST_MIPMAP_LINEAR;
+        params.flip = true;
+        params.channels = 3;
+        spirit_texture = TextureCache::get().acquire(PATH_TO_TEXTURE "/spirit_uv.jpg", params);
         spirit->setName("spirit");
 
         //Create the rigidbody for 3D object
@@ -42,44 +48,35 @@ public:
     }
 
     /** Setup the different parameters/uniform of the shaders used for the 3D object **/
-    void setup_spirit_shader(float ambient, float diffuse, float specular, glm::vec3 light_pos, glm::vec3 light_dir){
+    void setup_spirit_shader(float ambient, float diffuse, float specular){
         shader.use();
-        glActiveTexture(GL_TEXTURE0+1);
-        glBindTexture(GL_TEXTURE_2D, spirit_texture);
-        shader.setInteger("my_texture",1);
+        shader.setInteger("my_texture",UNIT_SPIRIT);
         shader.setFloat("light.ambient_strength", 0.9);
         shader.setFloat("light.diffuse_strength", 0.7);
         shader.setFloat("light.specular_strength", 0.9);
         shader.setFloat("light.constant", 0.9);
         shader.setFloat("light.linear", 0.7);
         shader.setFloat("light.quadratic", 0.0);
-        shader.setVector3f("light.light_pos",light_pos);
-        shader.setVector3f("dir_light.direction",light_dir);
         shader.setFloat("dir_light.ambient", 0.0f);
         shader.setFloat("dir_light.diffuse", 0.6f);
         shader.setFloat("dir_light.specular", 0.3f);
     }
 
-    /** Bind your vertex arrays and call glDrawArrays and setup the MVP matrix **/
-    void draw(Camera* camera, glm::vec3 light_pos){
+    /** Bind your vertex arrays and call glDrawArrays and setup the model matrix, the camera and the lights come from the uniform blocks **/
+    void draw(){
+        if (!spirit_texture->resident) return;
         shader.use();
-        glActiveTexture(GL_TEXTURE0+1);
-        glBindTexture(GL_TEXTURE_2D, spirit_texture);
-        shader.setInteger("my_texture",1);
-        shader.setVector3f("light.light_pos",light_pos);
-		shader.setVector3f("u_view_pos", camera->Position);
+        spirit_texture->bind(UNIT_SPIRIT);
 		shader.setMatrix4("M", spirit->transform.model);
 		shader.setMatrix4("itM", glm::inverseTranspose(spirit->transform.model));
-		shader.setMatrix4("V", camera->GetViewMatrix());
-		shader.setMatrix4("P", camera->GetProjectionMatrix());
 		spirit->draw();
     }  
 
     /** Bind your vertex arrays and call glDrawArrays withou VP matrix for the depth pass **/
-    void draw_depth(Camera* camera, Shader shader){
+    void draw_depth(Camera* camera, ShaderProgram shader){
         shader.use();
 		shader.setMatrix4("M", spirit->transform.model);
-		spirit->draw();
+		spirit->draw(shader);
     }  
     Object* getObject(){
         return spirit;
@@ -89,30 +86,6 @@ public:
         return this->rigid_body;
     }
 
-    /** Load the texture into the 'texture_nb' channel with the appropriate parameters **/
-    unsigned int loadTexture(char const * path, int texture_nb){
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glActiveTexture(GL_TEXTURE0+texture_nb);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        stbi_set_flip_vertically_on_load(true);
-        int imWidth, imHeight, imNrChannels;
-        unsigned char* data = stbi_load(path, &imWidth, &imHeight, &imNrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imWidth, imHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else {
-            std::cout << "Failed to Load texture" << std::endl;
-            const char* reason = stbi_failure_reason();
-            std::cout << reason << std::endl;
-        }
-        stbi_image_free(data);
-        glActiveTexture(GL_TEXTURE0+texture_nb);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        return textureID;
-    }
 private:
 
     /** Setup the rigidbody of the plane (mass, position, shape) to interact with the physic engine**/
@@ -0,0 +1,260 @@
+/**
+* @brief This header file defines the TerrainCollider class, the heightfield of the terrain in the physic engine and
+* the height and normal queries of the terrain on the CPU
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TERRAIN_COLLIDER_H
+#define TERRAIN_COLLIDER_H
+
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <btBulletDynamicsCommon.h>
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+
+#include "./terrain_generation.h"
+#include "./physic.h"
+#include "./utils/simd.h"
+
+/**
+ * @brief The surface of the terrain as height.tes displaces it : the sample (i, j) of the heightmap is at
+ * x = i + 0.5 - width / 2, z = j + 0.5 - height / 2 and at the height SIZE_Y / 2 + red / 255 * TERRAIN_DISPLACEMENT,
+ * the surface between the samples is the bilinear filter of the texture. The same heights are given to a
+ * btHeightfieldTerrainShape so that the objects of the physic engine rest on what is drawn (Bullet splits each
+ * cell in two triangles where the GPU filters, they differ by a fraction of the slope inside a cell).
+ * The heightmap is shared with the Terrain, the collider must be made once the terrain is resident
+**/
+class TerrainCollider{
+public:
+    TerrainCollider(std::shared_ptr<HeightMap> heightmap) : heightmap(heightmap) {
+        scale = TERRAIN_DISPLACEMENT / 255.0f;
+        base = SIZE_Y / 2;
+    }
+
+    TerrainCollider(const TerrainCollider&) = delete;
+    TerrainCollider& operator=(const TerrainCollider&) = delete;
+
+    /** Add the heightfield to the world of 'physic', without mass so that it never moves **/
+    void addTo(Physic& physic){
+        if (body || !valid()) return;
+        const std::vector<short int>& samples = heightmap->heights;
+        short int lowest = *std::min_element(samples.begin(), samples.end());
+        short int highest = *std::max_element(samples.begin(), samples.end());
+        // the samples are read in place, the heightmap must outlive the shape
+        shape = new btHeightfieldTerrainShape(heightmap->width, heightmap->height, samples.data(), scale,
+                                              lowest * scale, highest * scale, 1, false);
+        // Bullet centers the shape on its bounds, the body is moved back by the center of the heights
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3(0.0f, base + (lowest + highest) * 0.5f * scale, 0.0f));
+        btDefaultMotionState* motion_state = new btDefaultMotionState(transform);
+        btRigidBody::btRigidBodyConstructionInfo info(0.0f, motion_state, shape, btVector3(0, 0, 0));
+        body = new btRigidBody(info);
+        world = physic.dynamics_world;
+        world->addRigidBody(body);
+    }
+
+    /** Remove the heightfield from the physic engine **/
+    void destroy(){
+        if (!body) return;
+        world->removeRigidBody(body);
+        delete body->getMotionState();
+        delete body;
+        delete shape;
+        body = nullptr;
+        shape = nullptr;
+    }
+
+    /** Height of the terrain at (x, z), the border samples continue outside of the heightmap **/
+    float heightAt(float x, float z) const {
+        Cell cell = locate(x, z);
+        float top = glm::mix(cell.h00, cell.h01, cell.u), bottom = glm::mix(cell.h10, cell.h11, cell.u);
+        return base + scale * glm::mix(top, bottom, cell.v);
+    }
+
+    /** Normal of the bilinear surface at (x, z) **/
+    glm::vec3 normalAt(float x, float z) const {
+        Cell cell = locate(x, z);
+        float dx = scale * glm::mix(cell.h01 - cell.h00, cell.h11 - cell.h10, cell.v);
+        float dz = scale * glm::mix(cell.h10 - cell.h00, cell.h11 - cell.h01, cell.u);
+        return glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+    }
+
+    /** heightAt() of 'count' points given as one array per coordinate, four points at once **/
+    void heightsAt(const float* x, const float* z, float* heights, size_t count) const {
+        size_t i = 0;
+#if defined(SIMD_SSE) || defined(SIMD_NEON)
+        Cells cells;
+        for (; valid() && i + 4 <= count; i += 4){
+            locate4(x + i, z + i, cells);
+#if defined(SIMD_SSE)
+            __m128 u = _mm_loadu_ps(cells.u), v = _mm_loadu_ps(cells.v);
+            __m128 h00 = _mm_loadu_ps(cells.h00), h01 = _mm_loadu_ps(cells.h01), h10 = _mm_loadu_ps(cells.h10), h11 = _mm_loadu_ps(cells.h11);
+            __m128 top = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h01, h00), u));
+            __m128 bottom = _mm_add_ps(h10, _mm_mul_ps(_mm_sub_ps(h11, h10), u));
+            __m128 h = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), v));
+            _mm_storeu_ps(heights + i, _mm_add_ps(_mm_set1_ps(base), _mm_mul_ps(_mm_set1_ps(scale), h)));
+#else
+            float32x4_t u = vld1q_f32(cells.u), v = vld1q_f32(cells.v);
+            float32x4_t h00 = vld1q_f32(cells.h00), h01 = vld1q_f32(cells.h01), h10 = vld1q_f32(cells.h10), h11 = vld1q_f32(cells.h11);
+            float32x4_t top = vmlaq_f32(h00, vsubq_f32(h01, h00), u);
+            float32x4_t bottom = vmlaq_f32(h10, vsubq_f32(h11, h10), u);
+            float32x4_t h = vmlaq_f32(top, vsubq_f32(bottom, top), v);
+            vst1q_f32(heights + i, vmlaq_n_f32(vdupq_n_f32(base), h, scale));
+#endif
+        }
+#endif
+        for (; i < count; i++) heights[i] = heightAt(x[i], z[i]);
+    }
+
+    /** normalAt() of 'count' points given as one array per coordinate, the normals are written one array per component **/
+    void normalsAt(const float* x, const float* z, float* nx, float* ny, float* nz, size_t count) const {
+        size_t i = 0;
+#if defined(SIMD_SSE)
+        Cells cells;
+        for (; valid() && i + 4 <= count; i += 4){
+            locate4(x + i, z + i, cells);
+            __m128 u = _mm_loadu_ps(cells.u), v = _mm_loadu_ps(cells.v);
+            __m128 h00 = _mm_loadu_ps(cells.h00), h01 = _mm_loadu_ps(cells.h01), h10 = _mm_loadu_ps(cells.h10), h11 = _mm_loadu_ps(cells.h11);
+            __m128 ex = _mm_sub_ps(h01, h00), fx = _mm_sub_ps(h11, h10);
+            __m128 ez = _mm_sub_ps(h10, h00), fz = _mm_sub_ps(h11, h01);
+            __m128 dx = _mm_mul_ps(_mm_set1_ps(-scale), _mm_add_ps(ex, _mm_mul_ps(_mm_sub_ps(fx, ex), v)));
+            __m128 dz = _mm_mul_ps(_mm_set1_ps(-scale), _mm_add_ps(ez, _mm_mul_ps(_mm_sub_ps(fz, ez), u)));
+            __m128 one = _mm_set1_ps(1.0f);
+            // (dx, 1, dz) / length, an exact square root keeps the result equal to normalAt()
+            __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), one), _mm_mul_ps(dz, dz))));
+            _mm_storeu_ps(nx + i, _mm_mul_ps(dx, inverse));
+            _mm_storeu_ps(ny + i, inverse);
+            _mm_storeu_ps(nz + i, _mm_mul_ps(dz, inverse));
+        }
+#elif defined(SIMD_NEON)
+        Cells cells;
+        for (; valid() && i + 4 <= count; i += 4){
+            locate4(x + i, z + i, cells);
+            float32x4_t u = vld1q_f32(cells.u), v = vld1q_f32(cells.v);
+            float32x4_t h00 = vld1q_f32(cells.h00), h01 = vld1q_f32(cells.h01), h10 = vld1q_f32(cells.h10), h11 = vld1q_f32(cells.h11);
+            float32x4_t ex = vsubq_f32(h01, h00), fx = vsubq_f32(h11, h10);
+            float32x4_t ez = vsubq_f32(h10, h00), fz = vsubq_f32(h11, h01);
+            float32x4_t dx = vmulq_n_f32(vmlaq_f32(ex, vsubq_f32(fx, ex), v), -scale);
+            float32x4_t dz = vmulq_n_f32(vmlaq_f32(ez, vsubq_f32(fz, ez), u), -scale);
+            float32x4_t squared = vmlaq_f32(vmlaq_f32(vdupq_n_f32(1.0f), dx, dx), dz, dz);
+            float lengths[4];
+            vst1q_f32(lengths, squared);
+            for (int lane = 0; lane < 4; lane++) lengths[lane] = 1.0f / std::sqrt(lengths[lane]);
+            float32x4_t inverse = vld1q_f32(lengths);
+            vst1q_f32(nx + i, vmulq_f32(dx, inverse));
+            vst1q_f32(ny + i, inverse);
+            vst1q_f32(nz + i, vmulq_f32(dz, inverse));
+        }
+#endif
+        for (; i < count; i++){
+            glm::vec3 normal = normalAt(x[i], z[i]);
+            nx[i] = normal.x;
+            ny[i] = normal.y;
+            nz[i] = normal.z;
+        }
+    }
+
+private:
+    /** The four samples around a point and the position of the point between them **/
+    struct Cell {
+        float h00, h01, h10, h11;
+        float u, v;
+    };
+
+    /** Cell of four points, one array per value, filled for the vectorized filters **/
+    struct Cells {
+        float h00[4], h01[4], h10[4], h11[4];
+        float u[4], v[4];
+    };
+
+    /** Index of the first sample of the cell along an axis of 'size' samples and the position in the cell **/
+    static void axis(float position, int size, int& index, float& t){
+        // the center of the sample i is at i + 0.5 - size / 2, like the texels of the texture
+        float texel = std::min(std::max(position + size * 0.5f - 0.5f, 0.0f), (float)(size - 1));
+        index = std::min((int)texel, size - 2);
+        t = texel - index;
+    }
+
+    Cell locate(float x, float z) const {
+        Cell cell;
+        const HeightMap& map = *heightmap;
+        if (!valid()) {
+            cell.h00 = cell.h01 = cell.h10 = cell.h11 = cell.u = cell.v = 0.0f;
+            return cell;
+        }
+        int i, j;
+        axis(x, map.width, i, cell.u);
+        axis(z, map.height, j, cell.v);
+        const short int* row = &map.heights[(size_t)j * map.width + i];
+        cell.h00 = row[0];
+        cell.h01 = row[1];
+        cell.h10 = row[map.width];
+        cell.h11 = row[map.width + 1];
+        return cell;
+    }
+
+    /**
+     * The cells of four points, the same as four locate(). The cells are found with vector instructions, the
+     * samples are read one by one : there is no gather before AVX2
+    **/
+    void locate4(const float* x, const float* z, Cells& cells) const {
+        const HeightMap& map = *heightmap;
+        float first_x[4], first_z[4];
+#if defined(SIMD_SSE)
+        __m128 zero = _mm_setzero_ps();
+        __m128 tx = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(x), _mm_set1_ps(map.width * 0.5f - 0.5f)), zero), _mm_set1_ps((float)(map.width - 1)));
+        __m128 tz = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(z), _mm_set1_ps(map.height * 0.5f - 0.5f)), zero), _mm_set1_ps((float)(map.height - 1)));
+        // the coordinates are positive, the truncation is the floor
+        __m128 ix = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(tx)), _mm_set1_ps((float)(map.width - 2)));
+        __m128 iz = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(tz)), _mm_set1_ps((float)(map.height - 2)));
+        _mm_storeu_ps(cells.u, _mm_sub_ps(tx, ix));
+        _mm_storeu_ps(cells.v, _mm_sub_ps(tz, iz));
+        _mm_storeu_ps(first_x, ix);
+        _mm_storeu_ps(first_z, iz);
+#elif defined(SIMD_NEON)
+        float32x4_t zero = vdupq_n_f32(0.0f);
+        float32x4_t tx = vminq_f32(vmaxq_f32(vaddq_f32(vld1q_f32(x), vdupq_n_f32(map.width * 0.5f - 0.5f)), zero), vdupq_n_f32((float)(map.width - 1)));
+        float32x4_t tz = vminq_f32(vmaxq_f32(vaddq_f32(vld1q_f32(z), vdupq_n_f32(map.height * 0.5f - 0.5f)), zero), vdupq_n_f32((float)(map.height - 1)));
+        float32x4_t ix = vminq_f32(vcvtq_f32_s32(vcvtq_s32_f32(tx)), vdupq_n_f32((float)(map.width - 2)));
+        float32x4_t iz = vminq_f32(vcvtq_f32_s32(vcvtq_s32_f32(tz)), vdupq_n_f32((float)(map.height - 2)));
+        vst1q_f32(cells.u, vsubq_f32(tx, ix));
+        vst1q_f32(cells.v, vsubq_f32(tz, iz));
+        vst1q_f32(first_x, ix);
+        vst1q_f32(first_z, iz);
+#else
+        for (int lane = 0; lane < 4; lane++){
+            int i, j;
+            axis(x[lane], map.width, i, cells.u[lane]);
+            axis(z[lane], map.height, j, cells.v[lane]);
+            first_x[lane] = (float)i;
+            first_z[lane] = (float)j;
+        }
+#endif
+        for (int lane = 0; lane < 4; lane++){
+            const short int* row = &map.heights[(size_t)first_z[lane] * map.width + (size_t)first_x[lane]];
+            cells.h00[lane] = row[0];
+            cells.h01[lane] = row[1];
+            cells.h10[lane] = row[map.width];
+            cells.h11[lane] = row[map.width + 1];
+        }
+    }
+
+    bool valid() const {
+        return heightmap->width >= 2 && heightmap->height >= 2;
+    }
+
+    std::shared_ptr<HeightMap> heightmap;
+    float scale, base;
+    btHeightfieldTerrainShape* shape = nullptr;
+    btRigidBody* body = nullptr;
+    btDiscreteDynamicsWorld* world = nullptr;
+};
+#endif
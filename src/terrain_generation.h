@@ -11,147 +11,266 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
 #include <iostream>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
 
-#include "./tess_shader.h"
+#include "./shader_program.h"
+#include "./texture_cache.h"
+#include "./camera.h"
+#include "./utils/terrain_quadtree.h"
+#include "./utils/primitive_counter.h"
+#include "./utils/terrain_normals.h"
 
 const unsigned int NUM_PATCH_PTS = 4;
 
 const float SIZE_X = 128.0f;
 const float SIZE_Y = 10.0f;
 const float SIZE_Z = 128.0f;
+// world height of a white texel above the base of the terrain, height.tes displaces by the red channel * 64 * 1.5
+const float TERRAIN_DISPLACEMENT = 64.0f * 1.5f;
+// highest tessellation of an edge, a power of two (the minimum GL_MAX_TESS_GEN_LEVEL)
+const float TERRAIN_MAX_TESS_LEVEL = 64.0f;
+// length on screen of a segment of a rough edge, a flat edge gets TERRAIN_FLAT_DETAIL times fewer segments
+const float TERRAIN_SEGMENT_PIXELS = 8.0f;
+const float TERRAIN_FLAT_DETAIL = 0.25f;
+// heightmap of the island, its normal map is cached next to it
+#define TERRAIN_HEIGHTMAP PATH_TO_TEXTURE "/new_island.png"
+
+/** Heights read from the red channel of the heightmap **/
+struct HeightMap {
+    int width = 0;
+    int height = 0;
+    std::vector<short int> heights;
+};
 
 /**
-* @brief Class that handle a 3D terrain object with a tesselation shader
+* @brief Class that handle a 3D terrain object with a tesselation shader. The patches are the nodes of a quadtree
+* selected each frame for the camera, only the visible ones are streamed to an instance buffer and drawn
 **/
 class Terrain{
 public:
-    TShader tessHeightMapShader = TShader(PATH_TO_SHADER "/terrain_generation/height.vs",PATH_TO_SHADER "/terrain_generation/height.fs",nullptr,PATH_TO_SHADER "/terrain_generation/height.tcs", PATH_TO_SHADER "/terrain_generation/height.tes");
-    unsigned int terrainVAO, terrainVBO;
-    std::vector<float> vertices;  
-    int terrain_width = 0;
-    int terrain_height = 0; 
-    unsigned rez = 20;  
+    ShaderProgram tessHeightMapShader = ShaderProgram(PATH_TO_SHADER "/terrain_generation/height.vs",PATH_TO_SHADER "/terrain_generation/height.fs",nullptr,PATH_TO_SHADER "/terrain_generation/height.tcs", PATH_TO_SHADER "/terrain_generation/height.tes");
+    unsigned int terrainVAO, patchVBO;
     btRigidBody* rigid;
     Object* terrain_obj;
     btCollisionShape* shape;
-    short int *heightData;
-    unsigned int texture;
+    std::shared_ptr<HeightMap> heightmap;
+    std::shared_ptr<TerrainQuadtree> quadtree;
+    unsigned int texture, roughness, normals;
+    // patches of the last frame drawn and dropped, shown in the title
+    CullingStats culling;
+    // triangles out of the tessellator, a few frames late
+    PrimitiveCounter triangles;
+    // heightmap, quadtree and normal map still loading or waiting for their upload
+    Residency residency;
 
-    /** Constructor**/
+    /** Constructor. The heightmap is decoded and the quadtree is built by a worker, the texture is filled later by the upload queue **/
     Terrain(){
         //Setup the 3D object
         terrain_obj = new Object();
+        heightmap = std::make_shared<HeightMap>();
+        quadtree = std::make_shared<TerrainQuadtree>();
 
-        // Load the texture and the height values
         glGenTextures(1, &texture);
-        glActiveTexture(GL_TEXTURE0+4);
-        glBindTexture(GL_TEXTURE_2D, texture); 
-        int width, height, nrChannels;
-        unsigned char *data = stbi_load(PATH_TO_TEXTURE "/new_island.png", &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
-            // Iterate through the image data and populate the heightfieldData array
-            heightData = (short int *) malloc(height*width*2);
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    // Extract the height value from the red channel of the pixel at position (x, y)
-                    heightData[y * width + x] = (short int) data[(y * width + x)];
+        glGenTextures(1, &roughness);
+        glGenTextures(1, &normals);
+        glGenVertexArrays(1, &terrainVAO);
+        glGenBuffers(1, &patchVBO);
+        attach_patches(terrainVAO, patchVBO);
+
+        std::shared_ptr<ImageData> image = std::make_shared<ImageData>();
+        std::shared_ptr<HeightMap> heights = heightmap;
+        std::shared_ptr<TerrainQuadtree> tree = quadtree;
+        GLuint texture_id = texture, roughness_id = roughness, normals_id = normals;
+        Residency residency = this->residency;
+        residency.add(2);
+        JobSystem::get().submit([image, heights, tree, normals_id, residency](){
+            // Load the texture and the height values
+            decode_image(TERRAIN_HEIGHTMAP, false, *image);
+            int width = image->width, height = image->height;
+            if (image->pixels)
+            {
+                std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
+                // Iterate through the image data and populate the heightfield data
+                heights->width = width;
+                heights->height = height;
+                heights->heights.resize((size_t)width * height);
+                for (int y = 0; y < height; y++) {
+                    for (int x = 0; x < width; x++) {
+                        // Extract the height value from the red channel of the pixel at position (x, y)
+                        heights->heights[y * width + x] = (short int) image->pixels[(size_t)(y * width + x) * image->channels];
+                    }
                 }
             }
-        }
-        else
-        {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
-
-        terrain_width = width;
-        terrain_height = height;
-
-        
-        // vertex generation
-        for(unsigned i = 0; i <= rez-1; i++)
-        {
-            for(unsigned j = 0; j <= rez-1; j++)
+            tree->build(heights->heights.data(), heights->width, heights->height, SIZE_Y / 2, TERRAIN_DISPLACEMENT);
+            bake_normals(heights, normals_id, residency);
+        }, [texture_id, roughness_id, image, tree, residency]() mutable {
+            if (image->pixels)
             {
-                vertices.push_back(-width/2.0f + width*i/(float)rez); // v.x
-                vertices.push_back(SIZE_Y/2); // v.y
-                vertices.push_back(-height/2.0f + height*j/(float)rez); // v.z
-                vertices.push_back(i / (float)rez); // u
-                vertices.push_back(j / (float)rez); // v
-
-                vertices.push_back(-width/2.0f + width*(i+1)/(float)rez); // v.x
-                vertices.push_back(SIZE_Y/2); // v.y
-                vertices.push_back(-height/2.0f + height*j/(float)rez); // v.z
-                vertices.push_back((i+1) / (float)rez); // u
-                vertices.push_back(j / (float)rez); // v
-
-                vertices.push_back(-width/2.0f + width*i/(float)rez); // v.x
-                vertices.push_back(SIZE_Y/2); // v.y
-                vertices.push_back(-height/2.0f + height*(j+1)/(float)rez); // v.z
-                vertices.push_back(i / (float)rez); // u
-                vertices.push_back((j+1) / (float)rez); // v
-
-                vertices.push_back(-width/2.0f + width*(i+1)/(float)rez); // v.x
-                vertices.push_back(SIZE_Y/2); // v.y
-                vertices.push_back(-height/2.0f + height*(j+1)/(float)rez); // v.z
-                vertices.push_back((i+1) / (float)rez); // u
-                vertices.push_back((j+1) / (float)rez); // v
+                TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D, texture_id);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->width, image->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                // the borders are clamped like in TerrainCollider, the heights match on both sides
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
             }
-        }
-        std::cout << "Loaded " << rez*rez << " patches of 4 control points each" << std::endl;
-        std::cout << "Processing " << rez*rez*4 << " vertices in vertex shader" << std::endl;
-        Load_buffer(); 
+            upload_roughness(roughness_id, *tree);
+            residency.done();
+        });
     }
 
 
-    /** Bind your vertex arrays and call glDrawArrays and setup the MVP matrix **/
-    void draw(Camera camera, glm::vec3 light_dir){
+    /**
+     * Select the patches seen by 'camera' and draw them with one instanced draw call of 4 control points each,
+     * the camera and the light come from the uniform blocks
+    **/
+    void draw(const Camera* camera){
+        if (!residency.ready()) return;
+        culling.reset();
+        quadtree->select(camera->frustum, camera->Position, patches, culling);
+        if (patches.empty()) {
+            triangles.primitives = 0;
+            return;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        // grow by doubling and orphan the storage of the previous frame, like InstancedBatch
+        while (capacity < patches.size()) capacity = capacity ? capacity * 2 : 64;
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(TerrainPatch), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, patches.size() * sizeof(TerrainPatch), patches.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the tessellation follows the size of the edges on screen
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
         tessHeightMapShader.use();
-        glActiveTexture(GL_TEXTURE0+4);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        tessHeightMapShader.setInteger("heightMap", 4);
-        tessHeightMapShader.setMatrix4("projection",camera.GetProjectionMatrix());
-        tessHeightMapShader.setMatrix4("view", camera.GetViewMatrix());
+        TextureBinder::get().bind(UNIT_HEIGHTMAP, GL_TEXTURE_2D, texture);
+        TextureBinder::get().bind(UNIT_TERRAIN_ROUGHNESS, GL_TEXTURE_2D, roughness);
+        TextureBinder::get().bind(UNIT_TERRAIN_NORMALS, GL_TEXTURE_2D, normals);
+        tessHeightMapShader.setInteger("heightMap", UNIT_HEIGHTMAP);
+        tessHeightMapShader.setInteger("roughnessMap", UNIT_TERRAIN_ROUGHNESS);
+        tessHeightMapShader.setInteger("normalMap", UNIT_TERRAIN_NORMALS);
         tessHeightMapShader.setMatrix4("model", glm::mat4(1.0f));
+        tessHeightMapShader.setVector2f("terrain_size", glm::vec2((float)heightmap->width, (float)heightmap->height));
+        tessHeightMapShader.setFloat("terrain_base", SIZE_Y / 2);
+        tessHeightMapShader.setFloat("terrain_height", TERRAIN_DISPLACEMENT);
+        tessHeightMapShader.setVector2f("viewport", glm::vec2((float)viewport[2], (float)viewport[3]));
+        tessHeightMapShader.setFloat("max_tess_level", TERRAIN_MAX_TESS_LEVEL);
+        tessHeightMapShader.setFloat("segment_pixels", TERRAIN_SEGMENT_PIXELS);
+        tessHeightMapShader.setFloat("flat_detail", TERRAIN_FLAT_DETAIL);
         tessHeightMapShader.setFloat("dir_light.ambient", 0.2f);
         tessHeightMapShader.setFloat("dir_light.diffuse", 0.6f);
         tessHeightMapShader.setFloat("dir_light.specular", 0.3f);
-        tessHeightMapShader.setVector3("dir_light.direction", light_dir);
-        tessHeightMapShader.setVector3("u_view_pos", camera.Position);
 
         glBindVertexArray(terrainVAO);
-        glDrawArrays(GL_PATCHES, 0, NUM_PATCH_PTS*rez*rez);
+        triangles.begin();
+        glDrawArraysInstanced(GL_PATCHES, 0, NUM_PATCH_PTS, (GLsizei)patches.size());
+        triangles.end();
+        glBindVertexArray(0);
     }
 
-    /** Destroy the buffers of the terrain **/
+    /** Destroy the buffers and the textures of the terrain **/
     void destroy(){
         glDeleteVertexArrays(1, &terrainVAO);
-        glDeleteBuffers(1, &terrainVBO);
+        glDeleteBuffers(1, &patchVBO);
+        glDeleteTextures(1, &texture);
+        glDeleteTextures(1, &roughness);
+        glDeleteTextures(1, &normals);
     }
 
 private:
-    /** Load the vertex information and link them to the buffer **/
-    void Load_buffer(){
-        glGenVertexArrays(1, &terrainVAO);
-        glBindVertexArray(terrainVAO);
+    /**
+     * Fill the normal map from its cache, or bake it from the heights with one band of rows per worker and cache it.
+     * The upload is queued once every band is done
+    **/
+    static void bake_normals(std::shared_ptr<HeightMap> heights, GLuint normals_id, Residency residency){
+        const float scale = TERRAIN_DISPLACEMENT / 255.0f;
+        std::shared_ptr<NormalMap> map = std::make_shared<NormalMap>();
+        auto upload = [normals_id, map, residency]() mutable {
+            upload_normals(normals_id, *map);
+            residency.done();
+        };
+        if (heights->heights.empty() || (load_normal_map(TERRAIN_HEIGHTMAP, scale, *map) && map->width == heights->width && map->height == heights->height)){
+            UploadQueue::get().push(upload);
+            return;
+        }
+        map->width = heights->width;
+        map->height = heights->height;
+        map->texels.resize((size_t)map->width * map->height);
+        int bands = std::max(1, std::min((int)JobSystem::get().size(), map->height));
+        int rows = (map->height + bands - 1) / bands;
+        std::shared_ptr<std::atomic<int>> remaining = std::make_shared<std::atomic<int>>(bands);
+        for (int band = 0; band < bands; band++){
+            int first = band * rows, last = std::min(first + rows, map->height);
+            JobSystem::get().submit([heights, map, scale, first, last, remaining, upload](){
+                sobel_normals(heights->heights.data(), map->width, map->height, scale, first, last, map->texels.data());
+                if (--*remaining > 0) return;
+                if (!write_normal_map(TERRAIN_HEIGHTMAP, scale, *map))
+                    std::cout << "WARNING::TERRAIN::Could not write the normal map of " << TERRAIN_HEIGHTMAP << std::endl;
+                UploadQueue::get().push(upload);
+            });
+        }
+    }
 
-        glGenBuffers(1, &terrainVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    /** The normal map is mipmapped so that the far patches read the mean of the normals they cover **/
+    static void upload_normals(GLuint normals, const NormalMap& map){
+        if (map.texels.empty()) return;
+        TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D, normals);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, map.width, map.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, map.texels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
 
-        // position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        // texCoord attribute
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(sizeof(float) * 3));
-        glEnableVertexAttribArray(1);
+    /** One level of the texture per level of the roughness pyramid, read without filtering by height.tcs **/
+    static void upload_roughness(GLuint roughness, const TerrainQuadtree& tree){
+        const std::vector<std::vector<unsigned char>>& levels = tree.roughness();
+        if (levels.empty()) return;
+        TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D, roughness);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = 0; level < levels.size(); level++){
+            GLsizei side = TERRAIN_ROUGHNESS_CELLS >> level;
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_R8, side, side, 0, GL_RED, GL_UNSIGNED_BYTE, levels[level].data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
+
+    /**
+     * The control points have no vertex buffer, height.vs places the corner gl_VertexID of the patch of the instance.
+     * The attributes of the patch advance once per instance
+    **/
+    static void attach_patches(GLuint terrainVAO, GLuint patchVBO){
+        glBindVertexArray(terrainVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+
+        // patch attribute
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainPatch), (void*)offsetof(TerrainPatch, node));
+        // heights attribute
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainPatch), (void*)offsetof(TerrainPatch, heights));
+        // edges attribute
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TerrainPatch), (void*)offsetof(TerrainPatch, edges));
+        for (GLuint location = 0; location < 3; location++){
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // patches of the frame, kept to reuse their storage
+    std::vector<TerrainPatch> patches;
+    size_t capacity = 0;
 };
-#endif
\ No newline at end of file
+#endif
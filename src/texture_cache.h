@@ -0,0 +1,342 @@
+/**
+* @brief This header file defines the TextureCache class sharing the textures loaded from a file (or from its baked ´.ktx´),
+* the texture units of the scene and the TextureBinder filtering the redundant bindings
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "./texture_loader.h"
+
+/** Texture unit of each role, the samplers of the shaders are set once with these values **/
+enum TextureUnit {
+    UNIT_SKYBOX = 0,
+    UNIT_SPIRIT = 1,
+    UNIT_GROUND_DIFFUSE = 2,
+    UNIT_GROUND_NORMAL = 3,
+    UNIT_HEIGHTMAP = 4,
+    UNIT_TERRAIN_ROUGHNESS = 5,
+    UNIT_SHADOW = 6,
+    UNIT_TERRAIN_NORMALS = 7,
+    UNIT_PARTICLE = 8,
+    // used to fill the textures so that an upload never replaces the texture bound to a role
+    UNIT_UPLOAD = 15,
+    UNIT_COUNT = 16
+};
+
+/**
+ * @brief Remember the texture bound to each unit and the active unit to skip the calls that wouldn't change anything.
+ * Every glActiveTexture/glBindTexture of the scene must go through it for the state it keeps to stay true
+**/
+class TextureBinder{
+public:
+    static TextureBinder& get(){
+        static TextureBinder binder;
+        return binder;
+    }
+
+    /** Bind 'texture' to 'target' of 'unit', returns false if it was already bound **/
+    bool bind(int unit, GLenum target, GLuint texture){
+        Binding& binding = bound[unit];
+        if (binding.texture == texture && binding.target == target) return false;
+        if (active != unit){
+            glActiveTexture(GL_TEXTURE0 + unit);
+            active = unit;
+        }
+        glBindTexture(target, texture);
+        binding.texture = texture;
+        binding.target = target;
+        return true;
+    }
+
+    /** Forget a deleted texture, OpenGL may give its name to a new texture **/
+    void forget(GLuint texture){
+        for (Binding& binding : bound)
+            if (binding.texture == texture) binding = Binding();
+    }
+
+    /** Forget everything, to call after some code bound textures without the binder **/
+    void invalidate(){
+        for (Binding& binding : bound) binding = Binding();
+        active = -1;
+    }
+
+private:
+    struct Binding {
+        GLenum target = 0;
+        GLuint texture = 0;
+    };
+    TextureBinder(){}
+    Binding bound[UNIT_COUNT];
+    int active = -1;
+};
+
+/** Sampler parameters and decoding options of a texture, part of its key in the cache **/
+struct TextureParams {
+    // GL_REPEAT, GL_CLAMP_TO_EDGE... 0 clamps the images with an alpha channel and repeats the others
+    GLenum wrap = 0;
+    GLenum min_filter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum mag_filter = GL_LINEAR;
+    bool flip = false;
+    // number of channels the image is converted to, 0 keeps the channels of the file
+    int channels = 0;
+
+    bool mipmaps() const {
+        return min_filter != GL_LINEAR && min_filter != GL_NEAREST;
+    }
+
+    std::string key() const {
+        return std::to_string(wrap) + "/" + std::to_string(min_filter) + "/" + std::to_string(mag_filter) + "/" +
+               std::to_string(flip) + "/" + std::to_string(channels);
+    }
+};
+
+/**
+ * @brief Texture living on the GPU, shared by every object using the same file with the same parameters.
+ * It's deleted when the last object using it is destroyed
+**/
+struct Texture {
+    GLuint id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    int width = 0, height = 0;
+    // false until every image of the texture is uploaded
+    bool resident = false;
+
+    Texture(){}
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    ~Texture(){
+        // the texture is already gone if the context was destroyed first
+        if (glfwGetCurrentContext() == nullptr || id == 0) return;
+        TextureBinder::get().forget(id);
+        glDeleteTextures(1, &id);
+    }
+
+    /** Bind the texture to 'unit' if it isn't already **/
+    void bind(int unit) const {
+        TextureBinder::get().bind(unit, target, id);
+    }
+};
+
+typedef std::shared_ptr<Texture> TextureHandle;
+
+/**
+ * @brief Cache of the textures loaded from a file. A file is decoded once per set of parameters and every later
+ * request returns the same texture while it's still in use
+**/
+class TextureCache{
+public:
+    static TextureCache& get(){
+        static TextureCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief Return the 2D texture of 'path', read by a worker from the baked ´.ktx´ (or decoded from the image)
+     * and uploaded by the upload queue if it's not loaded yet
+    **/
+    TextureHandle acquire(const std::string& path, const TextureParams& params = TextureParams()){
+        std::string key = path + "#" + params.key();
+        if (TextureHandle texture = find(key)) return texture;
+
+        TextureHandle texture = create(GL_TEXTURE_2D);
+        load_texture_async(path, params.flip, s3tc, Residency(), [texture, params](const TexturePayload& payload){
+            bool alpha;
+            texture->bind(UNIT_UPLOAD);
+            if (!upload_image(GL_TEXTURE_2D, payload, params, *texture, alpha)) return;
+            if (!payload.from_baked && params.mipmaps()) glGenerateMipmap(GL_TEXTURE_2D);
+            set_parameters(GL_TEXTURE_2D, params, params.wrap ? params.wrap : alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+            texture->resident = true;
+        }, params.channels);
+        textures[key] = texture;
+        return texture;
+    }
+
+    /**
+     * @brief Return the cubemap made of the 6 images of 'faces' (+X, -X, +Y, -Y, +Z, -Z). Each face is loaded by its
+     * own job and the last job to finish queues a single upload of the whole cubemap
+    **/
+    TextureHandle acquire_cubemap(const std::string faces[6], const TextureParams& params = TextureParams()){
+        std::string key = "cubemap";
+        for (int i = 0; i < 6; i++) key += "#" + faces[i];
+        key += "#" + params.key();
+        if (TextureHandle texture = find(key)) return texture;
+
+        TextureHandle texture = create(GL_TEXTURE_CUBE_MAP);
+        struct Faces {
+            std::string paths[6];
+            TexturePayload payloads[6];
+            std::atomic<int> remaining{6};
+        };
+        std::shared_ptr<Faces> loaded = std::make_shared<Faces>();
+        for (int i = 0; i < 6; i++) loaded->paths[i] = faces[i];
+        bool s3tc = this->s3tc, storage = this->storage;
+        for (int i = 0; i < 6; i++){
+            JobSystem::get().submit([texture, params, loaded, i, s3tc, storage](){
+                TexturePayload& payload = loaded->payloads[i];
+                payload.from_baked = load_baked_image(loaded->paths[i], params.flip, s3tc, payload.baked);
+                if (!payload.from_baked) decode_image(loaded->paths[i], params.flip, payload.image, params.channels);
+                if (--loaded->remaining > 0) return;
+
+                // the faces must share their format, a stale baked face sends every face back to its image
+                bool baked = true;
+                for (const TexturePayload& face : loaded->payloads)
+                    baked &= face.from_baked && same_layout(face.baked, loaded->payloads[0].baked);
+                for (int f = 0; f < 6 && !baked; f++){
+                    TexturePayload& face = loaded->payloads[f];
+                    if (!face.from_baked) continue;
+                    face.from_baked = false;
+                    decode_image(loaded->paths[f], params.flip, face.image, params.channels);
+                }
+                UploadQueue::get().push([texture, params, loaded, storage](){
+                    upload_cubemap(*texture, loaded->payloads, params, storage);
+                });
+            });
+        }
+        textures[key] = texture;
+        return texture;
+    }
+
+    /** Number of textures currently alive **/
+    size_t size(){
+        size_t count = 0;
+        for (auto& entry : textures)
+            if (!entry.second.expired()) count++;
+        return count;
+    }
+
+private:
+    /** Created by the first request, on the OpenGL thread **/
+    TextureCache(){
+        // BC5 (RGTC) is core since OpenGL 3.0, BC1 and BC3 need S3TC, they're decompressed by the workers without it
+        s3tc = GLAD_GL_EXT_texture_compression_s3tc != 0;
+        if (!s3tc) std::cout << "S3TC isn't supported, the baked textures are decompressed on the CPU" << std::endl;
+        storage = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage;
+    }
+
+    TextureHandle find(const std::string& key){
+        auto it = textures.find(key);
+        if (it != textures.end()) return it->second.lock();
+        return nullptr;
+    }
+
+    static TextureHandle create(GLenum target){
+        TextureHandle texture = std::make_shared<Texture>();
+        texture->target = target;
+        glGenTextures(1, &texture->id);
+        return texture;
+    }
+
+    /**
+     * @brief Fill 'target' (the texture or one face of the cubemap) with every level of the baked file when the
+     * texture uses mipmaps, its first level otherwise, or with the decoded image. Returns false without an image
+    **/
+    static bool upload_image(GLenum target, const TexturePayload& payload, const TextureParams& params, Texture& texture, bool& alpha){
+        if (payload.from_baked){
+            const KtxImage& baked = payload.baked;
+            const KtxHeader& header = baked.header;
+            GLuint levels = params.mipmaps() ? baked.level_count() : 1;
+            for (GLuint i = 0; i < levels; i++) upload_level(target, i, baked, baked.level(i), false);
+            glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            texture.width = header.pixel_width;
+            texture.height = header.pixel_height;
+            alpha = header.gl_base_internal_format == GL_RGBA;
+            return true;
+        }
+        const ImageData& image = payload.image;
+        if (!image.pixels) return false;
+        GLenum format = image.format();
+        GLenum internal_format = target == GL_TEXTURE_2D ? format : GL_RGB;
+        glTexImage2D(target, 0, internal_format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        texture.width = image.width;
+        texture.height = image.height;
+        alpha = format == GL_RGBA;
+        return true;
+    }
+
+    /** Upload one level of a baked image, into the storage already allocated with glTexStorage2D if 'storage' is set **/
+    static void upload_level(GLenum target, GLint i, const KtxImage& baked, const KtxLevel& level, bool storage){
+        const KtxHeader& header = baked.header;
+        if (baked.compressed()){
+            if (storage) glCompressedTexSubImage2D(target, i, 0, 0, level.width, level.height, header.gl_internal_format, level.size, level.data);
+            else glCompressedTexImage2D(target, i, header.gl_internal_format, level.width, level.height, 0, level.size, level.data);
+        }
+        else {
+            if (storage) glTexSubImage2D(target, i, 0, 0, level.width, level.height, header.gl_format, GL_UNSIGNED_BYTE, level.data);
+            else glTexImage2D(target, i, header.gl_internal_format, level.width, level.height, 0, header.gl_format, GL_UNSIGNED_BYTE, level.data);
+        }
+    }
+
+    /** True if two baked images can be the faces of the same cubemap **/
+    static bool same_layout(const KtxImage& a, const KtxImage& b){
+        return a.header.gl_internal_format == b.header.gl_internal_format && a.header.pixel_width == b.header.pixel_width &&
+               a.header.pixel_height == b.header.pixel_height && a.level_count() == b.level_count();
+    }
+
+    /**
+     * @brief Upload the 6 faces of a cubemap in one pass. With texture storage (OpenGL 4.2 or ARB_texture_storage)
+     * every level is allocated up front as immutable storage and filled afterwards
+    **/
+    static void upload_cubemap(Texture& texture, const TexturePayload faces[6], const TextureParams& params, bool storage){
+        bool baked = faces[0].from_baked;
+        int width = baked ? faces[0].baked.header.pixel_width : faces[0].image.width;
+        int height = baked ? faces[0].baked.header.pixel_height : faces[0].image.height;
+        for (int f = 0; f < 6 && !baked; f++){
+            if (!faces[f].image.pixels || faces[f].image.width != width || faces[f].image.height != height){
+                std::cout << "The faces of the cubemap don't have the same size" << std::endl;
+                return;
+            }
+        }
+        GLsizei levels = 1;
+        if (params.mipmaps()) levels = baked ? faces[0].baked.level_count() : (GLsizei)std::log2(std::max(width, height)) + 1;
+        // the decoded faces drop their alpha channel
+        GLenum internal_format = baked ? faces[0].baked.header.gl_internal_format : GL_RGB8;
+
+        texture.bind(UNIT_UPLOAD);
+        if (storage) glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internal_format, width, height);
+        for (int f = 0; f < 6; f++){
+            GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + f;
+            if (baked){
+                for (GLsizei i = 0; i < levels; i++) upload_level(target, i, faces[f].baked, faces[f].baked.level(i), storage);
+                continue;
+            }
+            const ImageData& image = faces[f].image;
+            if (storage) glTexSubImage2D(target, 0, 0, 0, width, height, image.format(), GL_UNSIGNED_BYTE, image.pixels);
+            else glTexImage2D(target, 0, internal_format, width, height, 0, image.format(), GL_UNSIGNED_BYTE, image.pixels);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        if (!baked && levels > 1) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        set_parameters(GL_TEXTURE_CUBE_MAP, params, params.wrap ? params.wrap : GL_CLAMP_TO_EDGE);
+        texture.width = width;
+        texture.height = height;
+        texture.resident = true;
+    }
+
+    static void set_parameters(GLenum target, const TextureParams& params, GLenum wrap){
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+        if (target == GL_TEXTURE_CUBE_MAP) glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, params.min_filter);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, params.mag_filter);
+    }
+
+    std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+    bool s3tc = false;
+    // immutable storage with glTexStorage2D
+    bool storage = false;
+};
+#endif
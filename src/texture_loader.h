@@ -0,0 +1,114 @@
+/**
+* @brief This header file defines the asynchronous loading of the images used by the textures, read from the baked
+* ´.ktx´ next to the source image when it's up to date and decoded by stb_image otherwise
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <functional>
+#include <glad/glad.h>
+// the implementation is compiled by the file defining STB_IMAGE_IMPLEMENTATION, a second include would compile it again
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+#include "./utils/job_system.h"
+#include "./utils/ktx.h"
+
+/**
+ * @brief Pixels of an image decoded by stb_image, freed with the image
+**/
+struct ImageData {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = nullptr;
+
+    ImageData(){}
+    ImageData(const ImageData&) = delete;
+    ImageData& operator=(const ImageData&) = delete;
+    ~ImageData(){
+        if (pixels) stbi_image_free(pixels);
+    }
+
+    /** Format matching the number of channels of the image **/
+    GLenum format() const {
+        return channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+    }
+};
+
+/** Decode an image, the flip only applies to the calling thread so that the workers don't interfere with each other **/
+inline void decode_image(const std::string& path, bool flip, ImageData& image, int desired_channels = 0){
+    stbi_set_flip_vertically_on_load_thread(flip);
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, desired_channels);
+    if (image.pixels && desired_channels) image.channels = desired_channels;
+    if (!image.pixels) std::cout << "Failed to Load texture " << path << ": " << stbi_failure_reason() << std::endl;
+}
+
+/**
+ * @brief Image of a texture, the levels of the baked file when 'from_baked' is set and the decoded source otherwise
+**/
+struct TexturePayload {
+    ImageData image;
+    KtxImage baked;
+    bool from_baked = false;
+};
+
+/**
+ * @brief Map the baked ´.ktx´ of the image 'path' if it was made from the current version of the image. The levels are
+ * flipped and, if the driver can't sample them ('s3tc' false for BC1/BC3), decompressed to RGBA8 here on the worker.
+ * Returns false when the source has to be decoded instead
+**/
+inline bool load_baked_image(const std::string& path, bool flip, bool s3tc, KtxImage& baked){
+    int64_t mtime;
+    uint64_t size;
+    if (!file_info(path.c_str(), mtime, size)) return false;
+    if (!load_ktx(replace_extension(path, ".ktx").c_str(), baked)) return false;
+    if (baked.source != ktx_source_stamp(mtime, size)) return false;
+
+    uint32_t format = baked.header.gl_internal_format;
+    bool decompress = baked.compressed() && format != KTX_BC5 && !s3tc;
+    for (uint32_t level = 0; level < baked.level_count(); level++){
+        for (uint32_t face = 0; face < baked.face_count(); face++){
+            std::vector<unsigned char> data;
+            if (flip){
+                // a block-compressed level can't always be flipped, stb_image does it then
+                if (!flip_ktx_level(format, baked.level(level, face), data)) return false;
+                baked.replace(level, face, std::move(data));
+            }
+            if (decompress){
+                decompress_ktx_level(format, baked.level(level, face), data);
+                baked.replace(level, face, std::move(data));
+            }
+        }
+    }
+    if (decompress){
+        baked.header.gl_internal_format = KTX_RGBA8;
+        baked.header.gl_format = KTX_RGBA;
+        baked.header.gl_type = KTX_UNSIGNED_BYTE;
+    }
+    return true;
+}
+
+/**
+ * @brief Load the image of 'path' on a worker thread and call 'upload' with it on the OpenGL thread.
+ * The 'residency' of the asset is held until the upload is done, 'upload' must check 'from_baked' and 'image.pixels'
+**/
+inline void load_texture_async(const std::string& path, bool flip, bool s3tc, Residency residency,
+                               std::function<void(const TexturePayload&)> upload, int desired_channels = 0){
+    std::shared_ptr<TexturePayload> payload = std::make_shared<TexturePayload>();
+    residency.add();
+    JobSystem::get().submit([path, flip, s3tc, payload, desired_channels](){
+        payload->from_baked = load_baked_image(path, flip, s3tc, payload->baked);
+        if (!payload->from_baked) decode_image(path, flip, payload->image, desired_channels);
+    }, [payload, upload, residency]() mutable {
+        upload(*payload);
+        residency.done();
+    });
+}
+#endif
@@ -0,0 +1,318 @@
+/**
+* @brief This header file defines the TiledTerrain class, a terrain streamed tile by tile from a ´.tiles´ pack
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TILED_TERRAIN_H
+#define TILED_TERRAIN_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+
+#include "./shader_program.h"
+#include "./texture_cache.h"
+#include "./camera.h"
+#include "./terrain_generation.h"
+#include "./utils/terrain_tiles.h"
+#include "./utils/job_system.h"
+
+// layers of the texture array, the tiles resident at once whatever the size of the world
+const int TERRAIN_TILE_SLOTS = 32;
+// tiles kept around the tile of the camera on each side, (2 * radius + 1)^2 must stay below the number of slots
+const int TERRAIN_TILE_RADIUS = 2;
+// tiles read by the workers at once, it bounds the memory of the tiles on their way to the GPU
+const int TERRAIN_TILE_LOADS = 4;
+
+/** Per-instance attributes of a patch of a tile, the same locations as TerrainPatch **/
+struct TilePatch {
+    // corner and size of the patch in the coordinates of its tile
+    glm::vec3 node;
+    // lowest and highest world height of the displaced patch
+    glm::vec2 heights;
+    // layer of the tile, world corner (x, z) and world size of the tile
+    glm::vec4 tile;
+};
+
+/** Samples of a tile read by a worker, waiting for the upload to its layer **/
+struct TileLoad {
+    std::vector<uint16_t> samples;
+    glm::vec2 bounds[TERRAIN_TILE_PATCHES * TERRAIN_TILE_PATCHES];
+};
+
+/** A layer of the texture array and the tile it holds **/
+struct TileSlot {
+    int tile = -1;
+    bool resident = false;
+    bool loading = false;
+    // frame the tile was last wanted, the least recently wanted tile is evicted first
+    uint64_t used = 0;
+    // bumped when the slot gets a new tile, an upload for an evicted tile is dropped
+    uint64_t generation = 0;
+    glm::vec2 bounds[TERRAIN_TILE_PATCHES * TERRAIN_TILE_PATCHES];
+};
+
+/**
+ * @brief Terrain of a pack made by the terrain_tiles tool. The tiles around the camera are read by the workers from
+ * the mapped pack and uploaded in a layer of a texture array of TERRAIN_TILE_SLOTS layers, the least recently
+ * wanted tile gives its layer to the new one. The memory used (GPU and CPU) doesn't depend on the size of the world.
+ * It's drawn by the tessellation shaders of the Terrain built with TILED 1
+**/
+class TiledTerrain{
+public:
+    CullingStats culling;
+    PrimitiveCounter triangles;
+
+    /** Map the pack 'path', nothing is drawn if it can't be opened **/
+    TiledTerrain(const std::string& path){
+        pack = std::make_shared<TilePack>();
+        if (!pack->open(path)) {
+            std::cout << "Failed to open the terrain tiles " << path << std::endl;
+            pack.reset();
+            return;
+        }
+        const TilePackHeader& header = pack->header;
+        std::cout << "Tiled terrain of " << header.tiles_x << " x " << header.tiles_z << " tiles of " << header.tile_size << std::endl;
+
+        glGenTextures(1, &tiles);
+        TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D_ARRAY, tiles);
+        for (uint32_t level = 0; level < header.levels; level++){
+            GLsizei side = (GLsizei)tile_level_side(header.tile_size, level);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, GL_R16, side, side, TERRAIN_TILE_SLOTS, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)header.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &patchVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TilePatch), (void*)offsetof(TilePatch, node));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TilePatch), (void*)offsetof(TilePatch, heights));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TilePatch), (void*)offsetof(TilePatch, tile));
+        for (GLuint location = 0; location < 3; location++){
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        slots = std::make_shared<std::vector<TileSlot>>(TERRAIN_TILE_SLOTS);
+    }
+
+    TiledTerrain(const TiledTerrain&) = delete;
+    TiledTerrain& operator=(const TiledTerrain&) = delete;
+
+    /** Request the tiles around 'camera', nearest first, a tile far from the camera is evicted when a layer is needed **/
+    void update(const Camera* camera){
+        if (!pack) return;
+        frame++;
+        const TilePackHeader& header = pack->header;
+        float tile_world = header.tile_size * header.spacing;
+        int center_x = (int)std::floor((camera->Position.x - origin().x) / tile_world);
+        int center_z = (int)std::floor((camera->Position.z - origin().y) / tile_world);
+
+        std::vector<std::pair<int, int>> wanted;
+        for (int z = center_z - TERRAIN_TILE_RADIUS; z <= center_z + TERRAIN_TILE_RADIUS; z++){
+            for (int x = center_x - TERRAIN_TILE_RADIUS; x <= center_x + TERRAIN_TILE_RADIUS; x++){
+                if (x < 0 || z < 0 || x >= (int)header.tiles_x || z >= (int)header.tiles_z) continue;
+                int ring = std::max(std::abs(x - center_x), std::abs(z - center_z));
+                wanted.push_back(std::make_pair(ring, z * (int)header.tiles_x + x));
+            }
+        }
+        std::sort(wanted.begin(), wanted.end());
+
+        // the wanted tiles are marked first so that none of them is evicted for another one
+        std::vector<int> missing;
+        for (const auto& tile : wanted){
+            TileSlot* slot = find(tile.second);
+            if (slot) slot->used = frame;
+            else missing.push_back(tile.second);
+        }
+        for (int tile : missing){
+            if (loading() >= TERRAIN_TILE_LOADS) break;
+            TileSlot* slot = evict();
+            if (!slot) break;
+            load(*slot, tile);
+        }
+    }
+
+    /** Draw the patches of the resident tiles seen by 'camera' with one instanced draw call **/
+    void draw(const Camera* camera){
+        culling.reset();
+        if (!pack) return;
+        const TilePackHeader& header = pack->header;
+        float tile_world = header.tile_size * header.spacing, patch_world = tile_world / TERRAIN_TILE_PATCHES;
+        patches.clear();
+        for (size_t layer = 0; layer < slots->size(); layer++){
+            const TileSlot& slot = (*slots)[layer];
+            if (!slot.resident) continue;
+            glm::vec2 corner = origin() + glm::vec2(slot.tile % header.tiles_x, slot.tile / header.tiles_x) * tile_world;
+            for (int z = 0; z < TERRAIN_TILE_PATCHES; z++){
+                for (int x = 0; x < TERRAIN_TILE_PATCHES; x++){
+                    glm::vec2 bounds = slot.bounds[z * TERRAIN_TILE_PATCHES + x];
+                    glm::vec3 bounds_min(corner.x + x * patch_world, bounds.x, corner.y + z * patch_world);
+                    glm::vec3 bounds_max = bounds_min + glm::vec3(patch_world, bounds.y - bounds.x, patch_world);
+                    if (!culling.count(camera->frustum.intersects(bounds_min, bounds_max))) continue;
+                    TilePatch patch;
+                    patch.node = glm::vec3((float)x / TERRAIN_TILE_PATCHES, (float)z / TERRAIN_TILE_PATCHES, 1.0f / TERRAIN_TILE_PATCHES);
+                    patch.heights = bounds;
+                    patch.tile = glm::vec4((float)layer, corner.x, corner.y, tile_world);
+                    patches.push_back(patch);
+                }
+            }
+        }
+        if (patches.empty()) {
+            triangles.primitives = 0;
+            return;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        while (capacity < patches.size()) capacity = capacity ? capacity * 2 : 256;
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(TilePatch), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, patches.size() * sizeof(TilePatch), patches.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        shader.use();
+        TextureBinder::get().bind(UNIT_HEIGHTMAP, GL_TEXTURE_2D_ARRAY, tiles);
+        shader.setInteger("heightTiles", UNIT_HEIGHTMAP);
+        shader.setMatrix4("model", glm::mat4(1.0f));
+        shader.setFloat("terrain_base", SIZE_Y / 2);
+        shader.setFloat("terrain_height", header.height);
+        shader.setFloat("tile_samples", (float)header.tile_size);
+        shader.setVector2f("viewport", glm::vec2((float)viewport[2], (float)viewport[3]));
+        shader.setFloat("max_tess_level", TERRAIN_MAX_TESS_LEVEL);
+        shader.setFloat("segment_pixels", TERRAIN_SEGMENT_PIXELS);
+        shader.setFloat("dir_light.ambient", 0.2f);
+        shader.setFloat("dir_light.diffuse", 0.6f);
+        shader.setFloat("dir_light.specular", 0.3f);
+
+        glBindVertexArray(VAO);
+        triangles.begin();
+        glDrawArraysInstanced(GL_PATCHES, 0, NUM_PATCH_PTS, (GLsizei)patches.size());
+        triangles.end();
+        glBindVertexArray(0);
+    }
+
+    /** Number of tiles in the texture array **/
+    int resident() const {
+        int count = 0;
+        if (slots) for (const TileSlot& slot : *slots) count += slot.resident;
+        return count;
+    }
+
+    void destroy(){
+        if (!pack) return;
+        glDeleteTextures(1, &tiles);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &patchVBO);
+    }
+
+private:
+    /** World corner (x, z) of the first tile, the world is centered on the origin like the island **/
+    glm::vec2 origin() const {
+        const TilePackHeader& header = pack->header;
+        return -0.5f * glm::vec2(header.tiles_x, header.tiles_z) * (header.tile_size * header.spacing);
+    }
+
+    int loading() const {
+        int count = 0;
+        for (const TileSlot& slot : *slots) count += slot.loading;
+        return count;
+    }
+
+    TileSlot* find(int tile){
+        for (TileSlot& slot : *slots)
+            if (slot.tile == tile) return &slot;
+        return nullptr;
+    }
+
+    /** A free layer, or the one of the least recently wanted tile that isn't wanted by this frame **/
+    TileSlot* evict(){
+        TileSlot* oldest = nullptr;
+        for (TileSlot& slot : *slots){
+            if (slot.tile < 0) return &slot;
+            if (slot.loading || slot.used == frame) continue;
+            if (!oldest || slot.used < oldest->used) oldest = &slot;
+        }
+        return oldest;
+    }
+
+    /** Read the tile on a worker, with the bounds of its patches, then upload every level in the layer of 'slot' **/
+    void load(TileSlot& slot, int tile){
+        slot.tile = tile;
+        slot.resident = false;
+        slot.loading = true;
+        slot.used = frame;
+        slot.generation++;
+
+        std::shared_ptr<TilePack> pack = this->pack;
+        std::shared_ptr<std::vector<TileSlot>> slots = this->slots;
+        std::shared_ptr<TileLoad> payload = std::make_shared<TileLoad>();
+        size_t layer = &slot - &(*slots)[0];
+        uint64_t generation = slot.generation;
+        GLuint texture = tiles;
+        JobSystem::get().submit([pack, payload, tile](){
+            const TilePackHeader& header = pack->header;
+            const uint16_t* samples = pack->tile(tile % header.tiles_x, tile / header.tiles_x);
+            payload->samples.assign(samples, samples + tile_samples(header.tile_size, header.levels));
+            // the bilinear filter reads the samples on the border of a patch, they're part of both patches
+            uint32_t side = header.tile_size + 1, span = header.tile_size / TERRAIN_TILE_PATCHES;
+            for (int z = 0; z < TERRAIN_TILE_PATCHES; z++){
+                for (int x = 0; x < TERRAIN_TILE_PATCHES; x++){
+                    uint16_t lowest = 65535, highest = 0;
+                    for (uint32_t row = z * span; row <= std::min(side - 1, (z + 1) * span); row++){
+                        for (uint32_t column = x * span; column <= std::min(side - 1, (x + 1) * span); column++){
+                            uint16_t sample = payload->samples[(size_t)row * side + column];
+                            lowest = std::min(lowest, sample);
+                            highest = std::max(highest, sample);
+                        }
+                    }
+                    payload->bounds[z * TERRAIN_TILE_PATCHES + x] = glm::vec2(SIZE_Y / 2 + header.height * lowest / 65535.0f,
+                                                                              SIZE_Y / 2 + header.height * highest / 65535.0f);
+                }
+            }
+        }, [pack, payload, slots, layer, generation, texture]() {
+            TileSlot& slot = (*slots)[layer];
+            // the tile was evicted while it was read
+            if (slot.generation != generation) return;
+            const TilePackHeader& header = pack->header;
+            TextureBinder::get().bind(UNIT_UPLOAD, GL_TEXTURE_2D_ARRAY, texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+            const uint16_t* samples = payload->samples.data();
+            for (uint32_t level = 0; level < header.levels; level++){
+                GLsizei side = (GLsizei)tile_level_side(header.tile_size, level);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)layer, side, side, 1, GL_RED, GL_UNSIGNED_SHORT, samples);
+                samples += (size_t)side * side;
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            std::copy(payload->bounds, payload->bounds + TERRAIN_TILE_PATCHES * TERRAIN_TILE_PATCHES, slot.bounds);
+            slot.loading = false;
+            slot.resident = true;
+        });
+    }
+
+    ShaderProgram shader = ShaderProgram(PATH_TO_SHADER "/terrain_generation/height.vs", PATH_TO_SHADER "/terrain_generation/height.fs", nullptr,
+                                         PATH_TO_SHADER "/terrain_generation/height.tcs", PATH_TO_SHADER "/terrain_generation/height.tes", {{"TILED", "1"}});
+    std::shared_ptr<TilePack> pack;
+    std::shared_ptr<std::vector<TileSlot>> slots;
+    GLuint tiles = 0, VAO = 0, patchVBO = 0;
+    std::vector<TilePatch> patches;
+    size_t capacity = 0;
+    uint64_t frame = 0;
+};
+#endif
@@ -0,0 +1,42 @@
+/**
+* @brief Command line tool that pre-bakes the ´.mesh´ cache of every ´.obj´ file of a directory
+* and reports the vertex count and the average cache miss ratio before and after the optimization
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "../utils/mesh_cache.h"
+
+int main(int argc, char* argv[]){
+	std::string dir = argc > 1 ? argv[1] : PATH_TO_OBJECTS;
+
+	std::vector<std::string> files = list_directory(dir, ".obj");
+	if (files.empty()) {
+		std::cout << "No .obj file found in " << dir << std::endl;
+		return 1;
+	}
+
+	std::printf("%-20s %9s %9s %9s %10s %11s %13s %6s\n", "file", "triangles", "soup vtx", "indexed", "soup ACMR",
+	            "input ACMR", "optimized ACMR", "index");
+	int failed = 0;
+	for (const std::string& file : files){
+		MeshData mesh;
+		uint64_t source_hash;
+		MeshBuildStats stats;
+		if (!build_mesh(file.c_str(), mesh, source_hash, &stats) || !write_mesh_cache(file.c_str(), mesh, source_hash)){
+			std::cout << "Failed to bake " << file << std::endl;
+			failed++;
+			continue;
+		}
+		size_t name_start = file.find_last_of('/') + 1;
+		std::printf("%-20s %9u %9u %9u %10.3f %11.3f %13.3f %5ub\n", file.c_str() + name_start, stats.triangles, stats.soup_vertices,
+		            stats.unique_vertices, stats.soup_acmr, stats.indexed_acmr, stats.optimized_acmr, mesh.index_size * 8);
+	}
+	return failed ? 1 : 0;
+}
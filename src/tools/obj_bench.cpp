@@ -0,0 +1,117 @@
+/**
+* @brief Microbenchmark comparing the in place ´.obj´ loader with the previous istringstream based parser
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "../utils/obj_loader.h"
+
+/** The parser previously used by Object(const char* path), kept as the reference of the benchmark **/
+static size_t legacy_parse(const char* path){
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<Vertex> vertices;
+	std::ifstream infile(path);
+	std::string line;
+	while (std::getline(infile, line))
+	{
+		std::istringstream iss(line);
+		std::string indice;
+		iss >> indice;
+		if (indice == "v") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			positions.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vn") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			normals.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vt") {
+			float u, v;
+			iss >> u >> v;
+			textures.push_back(glm::vec2(u, v));
+		}
+		else if (indice == "f") {
+			std::string f[3];
+			iss >> f[0] >> f[1] >> f[2];
+			for (int i = 0; i < 3; i++) {
+				std::string p, t, n;
+				Vertex v;
+				p = f[i].substr(0, f[i].find("/"));
+				f[i].erase(0, f[i].find("/") + 1);
+				t = f[i].substr(0, f[i].find("/"));
+				f[i].erase(0, f[i].find("/") + 1);
+				n = f[i].substr(0, f[i].find("/"));
+				v.Position = positions.at(std::stof(p) - 1);
+				v.Normal = normals.at(std::stof(n) - 1);
+				v.Texture = textures.at(std::stof(t) - 1);
+				vertices.push_back(v);
+			}
+		}
+	}
+	infile.close();
+	return vertices.size();
+}
+
+static size_t mapped_parse(const char* path){
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<Vertex> vertices;
+	load_obj(path, positions, textures, normals, vertices);
+	return vertices.size();
+}
+
+/** Run 'parse' 'iterations' times and return the mean time in microseconds **/
+template <typename F>
+static double time_parser(F parse, const char* path, int iterations, size_t& vertices){
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) vertices = parse(path);
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main(int argc, char* argv[]){
+	std::string dir = argc > 1 ? argv[1] : PATH_TO_OBJECTS;
+	int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	std::vector<std::string> files = list_directory(dir, ".obj");
+	if (files.empty()) {
+		std::cout << "No .obj file found in " << dir << std::endl;
+		return 1;
+	}
+
+	std::printf("%-24s %10s %12s %10s %12s %8s\n", "file", "legacy us", "legacy verts", "mapped us", "mapped verts", "speedup");
+	for (const std::string& file : files){
+		size_t name_start = file.find_last_of('/') + 1;
+		size_t legacy_vertices = 0, mapped_vertices = 0;
+		double legacy_time = -1.0;
+		try {
+			legacy_time = time_parser(legacy_parse, file.c_str(), iterations, legacy_vertices);
+		}
+		catch (std::exception&) {
+			// the legacy parser throws on faces without texture or normal indices
+		}
+		double mapped_time = time_parser(mapped_parse, file.c_str(), iterations, mapped_vertices);
+
+		if (legacy_time < 0.0)
+			std::printf("%-24s %10s %12s %10.1f %12zu %8s\n", file.c_str() + name_start, "failed", "-", mapped_time, mapped_vertices, "-");
+		else
+			std::printf("%-24s %10.1f %12zu %10.1f %12zu %7.1fx\n", file.c_str() + name_start, legacy_time, legacy_vertices,
+			            mapped_time, mapped_vertices, legacy_time / mapped_time);
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+/**
+* @brief Benchmark of the two particle backends : the CPU update with the live particles streamed to an instance buffer,
+* and the GPU update by transform feedback. It needs an OpenGL 4.0 context, opened in a hidden window
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "../camera.h"
+#include "../particles.h"
+
+// particles live 3 seconds, spawning amount / 180 per frame at 60 fps keeps the pool full
+const float BENCH_DT = 1.0f / 60.0f;
+const float BENCH_LIFE = 3.0f;
+
+/** Open a hidden window with an OpenGL 4.0 core context, the size of the framebuffer drawn to **/
+static GLFWwindow* open_context(int size){
+	if (!glfwInit()) return nullptr;
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(size, size, "particle_bench", nullptr, nullptr);
+	if (window == nullptr) return nullptr;
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) return nullptr;
+	return window;
+}
+
+/** Time of 'frames' frames of 'generator' in milliseconds, split between the update and the draw **/
+static void time_frames(ParticleGenerator& generator, Object* emitter, unsigned int spawn, int frames,
+                        double& update_ms, double& draw_ms){
+	update_ms = draw_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++){
+		glClear(GL_COLOR_BUFFER_BIT);
+		auto start = std::chrono::steady_clock::now();
+		generator.Update(BENCH_DT, spawn, emitter);
+		glFinish();
+		auto updated = std::chrono::steady_clock::now();
+		generator.draw();
+		glFinish();
+		auto drawn = std::chrono::steady_clock::now();
+		update_ms += std::chrono::duration<double, std::milli>(updated - start).count();
+		draw_ms += std::chrono::duration<double, std::milli>(drawn - updated).count();
+	}
+	update_ms /= frames;
+	draw_ms /= frames;
+}
+
+int main(int argc, char* argv[]){
+	int frames = argc > 1 ? std::atoi(argv[1]) : 60;
+	const int size = 512;
+	GLFWwindow* window = open_context(size);
+	if (window == nullptr) {
+		std::cout << "Failed to open an OpenGL 4.0 context" << std::endl;
+		return 1;
+	}
+	glViewport(0, 0, size, size);
+
+	//The camera looks at the emitter from the side
+	FrameData frame;
+	frame.V = glm::lookAt(glm::vec3(0.0f, 2.0f, -12.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frame.P = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	frame.lightspace = glm::mat4(1.0f);
+	frame.view_pos = glm::vec3(0.0f, 2.0f, -12.0f);
+	frame.time = 0.0f;
+	UniformBlocks::get().update_frame(frame);
+	Object emitter;
+
+	std::printf("%10s %8s %12s %12s %12s\n", "particles", "backend", "update ms", "draw ms", "frame ms");
+	for (unsigned int amount : {1000u, 100000u, 1000000u}){
+		for (ParticleBackend backend : {PARTICLES_CPU, PARTICLES_GPU}){
+			ParticleGenerator generator(amount, nullptr, nullptr, backend);
+			// the sprite is decoded by a worker and uploaded by the queue
+			while (!generator.batch.texture->resident) UploadQueue::get().drain(UPLOAD_BUDGET);
+
+			// fill the pool before timing, like after a few seconds of the scene
+			unsigned int spawn = std::max(1u, (unsigned int)(amount * BENCH_DT / BENCH_LIFE));
+			for (int warmup = 0; warmup < (int)(BENCH_LIFE / BENCH_DT); warmup++) generator.Update(BENCH_DT, spawn, &emitter);
+
+			double update_ms, draw_ms;
+			time_frames(generator, &emitter, spawn, frames, update_ms, draw_ms);
+			std::printf("%10u %8s %12.3f %12.3f %12.3f\n", amount, backend == PARTICLES_CPU ? "cpu" : "gpu",
+			            update_ms, draw_ms, update_ms + draw_ms);
+		}
+	}
+
+	JobSystem::get().wait_idle();
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
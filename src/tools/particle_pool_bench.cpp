@@ -0,0 +1,218 @@
+/**
+* @brief Microbenchmark of the CPU particle update : the structure-of-arrays pool with its vectorized kernel against
+* the previous array of Particle structs with its linear search of a free slot, and the back to front sorts of the
+* particles against std::sort. It doesn't need an OpenGL context
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "../utils/particle_pool.h"
+#include "../utils/particle_sort.h"
+
+// particles live 3 seconds, spawning amount / 180 per frame at 60 fps keeps the pool full
+const float BENCH_DT = 1.0f / 60.0f;
+const float BENCH_LIFE = 3.0f;
+
+/** The particle previously used by ParticleGenerator, kept as the reference of the benchmark **/
+struct LegacyParticle {
+	glm::vec3 Position, Velocity;
+	glm::vec4 Color;
+	float Life;
+
+	LegacyParticle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f) {}
+};
+
+/** The previous update : a linear search and three rand() per spawned particle, then a walk over every slot **/
+struct LegacyGenerator {
+	std::vector<LegacyParticle> particles;
+	unsigned int lastUsedParticle = 0;
+
+	LegacyGenerator(unsigned int amount) : particles(amount) {}
+
+	unsigned int firstUnusedParticle(){
+		for (unsigned int i = lastUsedParticle; i < particles.size(); ++i){
+			if (particles[i].Life <= 0.0f){
+				lastUsedParticle = i;
+				return i;
+			}
+		}
+		for (unsigned int i = 0; i < lastUsedParticle; ++i){
+			if (particles[i].Life <= 0.0f){
+				lastUsedParticle = i;
+				return i;
+			}
+		}
+		lastUsedParticle = 0;
+		return 0;
+	}
+
+	void update(float dt, unsigned int spawn){
+		for (unsigned int i = 0; i < spawn; ++i){
+			LegacyParticle& particle = particles[firstUnusedParticle()];
+			float random = ((rand() % 100) - 50) / 20.0f;
+			float rColor = 0.5f + ((rand() % 100) / 100.0f);
+			particle.Position = glm::vec3(-0.5f, 2.0f, 0.0f);
+			particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
+			particle.Life = BENCH_LIFE;
+			particle.Velocity = (rand() % 100 < 50 ? glm::vec3(0.2, 0.4, -0.2) : glm::vec3(-0.2, 0.4, 0.2)) * random;
+		}
+		for (LegacyParticle& p : particles){
+			p.Life -= dt;
+			if (p.Life > 0.0f){
+				p.Position += p.Velocity * dt;
+				p.Color.a -= dt * 2.5f;
+			}
+		}
+	}
+
+	unsigned int alive() const {
+		unsigned int count = 0;
+		for (const LegacyParticle& p : particles) count += p.Life > 0.0f;
+		return count;
+	}
+};
+
+/** The CPU update of ParticleGenerator on a pool, with the vectorized or the scalar kernel **/
+struct PoolGenerator {
+	ParticlePool pool;
+	ParticleRandom random;
+	bool simd;
+
+	PoolGenerator(unsigned int amount, bool simd) : pool(amount), simd(simd) {}
+
+	void update(float dt, unsigned int spawn){
+		for (unsigned int i = 0; i < spawn; ++i){
+			int slot = pool.spawn();
+			if (slot < 0) break;
+			float speed = random.uniform(-2.5f, 2.5f);
+			float rColor = random.uniform(0.5f, 1.5f);
+			glm::vec3 velocity = (random.next() & 0x80000000u ? glm::vec3(0.2, 0.4, -0.2) : glm::vec3(-0.2, 0.4, 0.2)) * speed;
+			pool.set((unsigned int)slot, glm::vec3(-0.5f, 2.0f, 0.0f), velocity, glm::vec4(rColor, rColor, rColor, 1.0f), BENCH_LIFE);
+		}
+		if (simd) pool.integrate(dt);
+		else pool.integrate_scalar(dt);
+		pool.compact();
+	}
+
+	unsigned int alive() const {
+		return pool.size();
+	}
+};
+
+/** Millions of particle updates per second over 'frames' frames of a full pool, the pool is filled first **/
+template <typename G>
+static double time_updates(G& generator, unsigned int amount, int frames){
+	unsigned int spawn = std::max(1u, (unsigned int)(amount * BENCH_DT / BENCH_LIFE));
+	for (int warmup = 0; warmup < (int)(BENCH_LIFE / BENCH_DT); warmup++) generator.update(BENCH_DT, spawn);
+
+	double updated = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++){
+		generator.update(BENCH_DT, spawn);
+		updated += generator.alive();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return updated / elapsed.count() / 1e6;
+}
+
+/** Mean time in microseconds of an update spawning 'burst' particles into a full pool **/
+template <typename G>
+static double time_burst(G& generator, unsigned int amount, unsigned int burst, int repeats){
+	generator.update(0.0f, amount);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; i++) generator.update(0.0f, burst);
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / repeats;
+}
+
+/** Mean time in milliseconds of a back to front sort of the particles of 'pool' seen from 'eye' along 'front' **/
+static double time_sort(const ParticlePool& pool, ParticleSort mode, int repeats, glm::vec3 eye, glm::vec3 front, bool& ordered){
+	ParticleSorter sorter;
+	sorter.mode = mode;
+	const std::vector<uint32_t>* order = nullptr;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; i++){
+		// the camera is still in the benchmark, without this the order would be reused
+		sorter.invalidate();
+		order = &sorter.sort(pool, eye, front);
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	// the buckets are only sorted to 1/2048 of the depth range (the sorted mode uses them above the threshold)
+	bool buckets = mode == PARTICLES_BUCKETED || pool.size() > PARTICLE_BUCKET_THRESHOLD;
+	float tolerance = buckets ? 1.0f / 1024.0f : 1.0f / 32768.0f;
+	float nearest = 1e30f, farthest = -1e30f;
+	for (unsigned int i = 0; i < pool.size(); i++){
+		float d = glm::dot(pool.position(i) - eye, front);
+		nearest = std::min(nearest, d);
+		farthest = std::max(farthest, d);
+	}
+	ordered = order->size() == pool.size();
+	for (size_t i = 1; ordered && i < order->size(); i++)
+		ordered = glm::dot(pool.position((*order)[i]) - eye, front) <= glm::dot(pool.position((*order)[i - 1]) - eye, front) + tolerance * (farthest - nearest);
+	return elapsed.count() / repeats;
+}
+
+/** Mean time in milliseconds of the same sort by std::sort on the exact depth **/
+static double time_std_sort(const ParticlePool& pool, int repeats, glm::vec3 eye, glm::vec3 front){
+	std::vector<uint32_t> order(pool.size());
+	std::vector<float> depth(pool.size());
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; i++){
+		for (unsigned int j = 0; j < pool.size(); j++){
+			order[j] = j;
+			depth[j] = glm::dot(pool.position(j) - eye, front);
+		}
+		std::sort(order.begin(), order.end(), [&depth](uint32_t a, uint32_t b){ return depth[a] > depth[b]; });
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / repeats;
+}
+
+int main(int argc, char* argv[]){
+	int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+
+	std::printf("kernel: %s, %u floats per register\n", particle_simd::name(), particle_simd::WIDTH);
+	std::printf("%10s %14s %14s %14s %8s\n", "particles", "legacy M/s", "soa M/s", "soa simd M/s", "speedup");
+	for (unsigned int amount : {10000u, 100000u, 1000000u}){
+		LegacyGenerator legacy(amount);
+		PoolGenerator scalar(amount, false), simd(amount, true);
+		double legacy_rate = time_updates(legacy, amount, frames);
+		double scalar_rate = time_updates(scalar, amount, frames);
+		double simd_rate = time_updates(simd, amount, frames);
+		std::printf("%10u %14.1f %14.1f %14.1f %7.1fx\n", amount, legacy_rate, scalar_rate, simd_rate, simd_rate / legacy_rate);
+	}
+
+	// a burst of 50 particles, like the collision of a sphere, into a full pool of 100000 particles
+	std::printf("%10s %14s %14s\n", "burst", "legacy us", "pool us");
+	LegacyGenerator legacy(100000);
+	PoolGenerator pool(100000, true);
+	double legacy_burst = time_burst(legacy, 100000, 50, 100);
+	double pool_burst = time_burst(pool, 100000, 50, 100);
+	std::printf("%10u %14.1f %14.1f\n", 50u, legacy_burst, pool_burst);
+
+	// back to front order of a full pool seen from the side of the emitter
+	glm::vec3 eye(0.0f, 2.0f, -12.0f), front(0.0f, 0.0f, 1.0f);
+	std::printf("%10s %14s %14s %14s\n", "particles", "std::sort ms", "radix ms", "buckets ms");
+	for (unsigned int amount : {10000u, 100000u, 1000000u}){
+		PoolGenerator generator(amount, true);
+		time_updates(generator, amount, 1);
+		int repeats = std::max(1, (int)(20000000u / amount));
+		bool radix_ordered, bucket_ordered;
+		double std_time = time_std_sort(generator.pool, repeats, eye, front);
+		double radix_time = time_sort(generator.pool, PARTICLES_SORTED, repeats, eye, front, radix_ordered);
+		double bucket_time = time_sort(generator.pool, PARTICLES_BUCKETED, repeats, eye, front, bucket_ordered);
+		std::printf("%10u %14.3f %13.3f%s %13.3f%s\n", generator.pool.size(), std_time, radix_time, radix_ordered ? " " : "!",
+		            bucket_time, bucket_ordered ? " " : "!");
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+/**
+* @brief Command line tool that cuts a heightmap into the ´.tiles´ pack streamed by the tiled terrain. The heightmap is
+* read with 16 bits per sample (an 8 bits image is widened), optionally upscaled, and every tile is written with all
+* its mip levels.
+* Usage : terrain_tiles [--tile 256] [--upscale 1] [--spacing 1] [--height 96] [heightmap] [pack]
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "../utils/terrain_tiles.h"
+
+/** Sample (x, z) of the source, the borders are repeated past the edges **/
+static float source_sample(const std::vector<uint16_t>& source, int width, int height, int x, int z){
+	x = std::min(std::max(x, 0), width - 1);
+	z = std::min(std::max(z, 0), height - 1);
+	return source[(size_t)z * width + x];
+}
+
+/** Bilinear upscale of the source by 'factor', the samples of the source are kept at every 'factor' samples **/
+static std::vector<uint16_t> upscale(const std::vector<uint16_t>& source, int& width, int& height, int factor){
+	int out_width = (width - 1) * factor + 1, out_height = (height - 1) * factor + 1;
+	std::vector<uint16_t> out((size_t)out_width * out_height);
+	for (int z = 0; z < out_height; z++){
+		int sz = z / factor;
+		float v = (float)(z % factor) / factor;
+		for (int x = 0; x < out_width; x++){
+			int sx = x / factor;
+			float u = (float)(x % factor) / factor;
+			float top = source_sample(source, width, height, sx, sz) * (1.0f - u) + source_sample(source, width, height, sx + 1, sz) * u;
+			float bottom = source_sample(source, width, height, sx, sz + 1) * (1.0f - u) + source_sample(source, width, height, sx + 1, sz + 1) * u;
+			out[(size_t)z * out_width + x] = (uint16_t)(top * (1.0f - v) + bottom * v + 0.5f);
+		}
+	}
+	width = out_width;
+	height = out_height;
+	return out;
+}
+
+/** Next level of a tile : each sample is the mean of the area it covers in 'finer', like the mip levels of OpenGL **/
+static std::vector<uint16_t> reduce(const std::vector<uint16_t>& finer, uint32_t side, uint32_t next){
+	std::vector<uint16_t> out((size_t)next * next);
+	for (uint32_t z = 0; z < next; z++){
+		uint32_t z0 = z * side / next, z1 = std::max(z0 + 1, (z + 1) * side / next);
+		for (uint32_t x = 0; x < next; x++){
+			uint32_t x0 = x * side / next, x1 = std::max(x0 + 1, (x + 1) * side / next);
+			double sum = 0.0;
+			for (uint32_t row = z0; row < z1; row++)
+				for (uint32_t column = x0; column < x1; column++) sum += finer[(size_t)row * side + column];
+			out[(size_t)z * next + x] = (uint16_t)(sum / ((z1 - z0) * (x1 - x0)) + 0.5);
+		}
+	}
+	return out;
+}
+
+int main(int argc, char* argv[]){
+	TilePackHeader header;
+	std::memcpy(header.magic, TILE_PACK_MAGIC, 4);
+	header.tile_size = 256;
+	header.spacing = 1.0f;
+	header.height = 96.0f;
+	header.reserved = 0;
+	int factor = 1;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "--tile" && i + 1 < argc) header.tile_size = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--upscale" && i + 1 < argc) factor = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--spacing" && i + 1 < argc) header.spacing = (float)std::atof(argv[++i]);
+		else if (arg == "--height" && i + 1 < argc) header.height = (float)std::atof(argv[++i]);
+		else paths.push_back(arg);
+	}
+	if (header.tile_size % TERRAIN_TILE_PATCHES != 0){
+		std::cout << "The tile size must be a multiple of " << TERRAIN_TILE_PATCHES << ", got " << header.tile_size << std::endl;
+		return 1;
+	}
+	std::string input = paths.size() > 0 ? paths[0] : PATH_TO_TEXTURE "/iceland_heightmap.png";
+	std::string output = paths.size() > 1 ? paths[1] : replace_extension(input, ".tiles");
+
+	// the whole source is held by this offline step only, the game reads the tiles one at a time
+	auto start = std::chrono::steady_clock::now();
+	int width, height, channels;
+	stbi_us* pixels = stbi_load_16(input.c_str(), &width, &height, &channels, 1);
+	if (!pixels){
+		std::cout << "Failed to load " << input << ": " << stbi_failure_reason() << std::endl;
+		return 1;
+	}
+	std::vector<uint16_t> source(pixels, pixels + (size_t)width * height);
+	stbi_image_free(pixels);
+	if (factor > 1) source = upscale(source, width, height, factor);
+
+	uint32_t tile = header.tile_size;
+	header.tiles_x = (uint32_t)std::max(1, (width - 1 + (int)tile - 1) / (int)tile);
+	header.tiles_z = (uint32_t)std::max(1, (height - 1 + (int)tile - 1) / (int)tile);
+	header.levels = tile_levels(tile);
+
+	FILE* out = std::fopen(output.c_str(), "wb");
+	if (!out){
+		std::cout << "Failed to write " << output << std::endl;
+		return 1;
+	}
+	size_t tiles = (size_t)header.tiles_x * header.tiles_z;
+	size_t tile_bytes = tile_samples(tile, header.levels) * sizeof(uint16_t);
+	std::vector<uint64_t> offsets(tiles);
+	for (size_t i = 0; i < tiles; i++) offsets[i] = sizeof(TilePackHeader) + tiles * sizeof(uint64_t) + i * tile_bytes;
+	std::fwrite(&header, sizeof(header), 1, out);
+	std::fwrite(offsets.data(), sizeof(uint64_t), tiles, out);
+
+	for (uint32_t tz = 0; tz < header.tiles_z; tz++){
+		for (uint32_t tx = 0; tx < header.tiles_x; tx++){
+			uint32_t side = tile + 1;
+			std::vector<uint16_t> level((size_t)side * side);
+			for (uint32_t z = 0; z < side; z++)
+				for (uint32_t x = 0; x < side; x++)
+					level[(size_t)z * side + x] = (uint16_t)source_sample(source, width, height, (int)(tx * tile + x), (int)(tz * tile + z));
+			for (uint32_t l = 0; l < header.levels; l++){
+				std::fwrite(level.data(), sizeof(uint16_t), level.size(), out);
+				uint32_t next = tile_level_side(tile, l + 1);
+				if (l + 1 < header.levels) level = reduce(level, side, next);
+				side = next;
+			}
+		}
+	}
+	bool written = std::ferror(out) == 0;
+	written = std::fclose(out) == 0 && written;
+	if (!written){
+		std::cout << "Failed to write " << output << std::endl;
+		return 1;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::printf("%s : %d x %d samples, %u x %u tiles of %u, %u levels, %.1f MB in %.0f ms\n", output.c_str(), width, height,
+	            header.tiles_x, header.tiles_z, tile, header.levels, (double)(offsets.empty() ? 0 : offsets.back() + tile_bytes) / 1e6, ms);
+	return 0;
+}
@@ -0,0 +1,188 @@
+/**
+* @brief Command line tool that bakes the images of the textures folders into ´.ktx´ files holding every mip level,
+* block-compressed (BC1 for opaque colors, BC3 with alpha) or uncompressed for the normal maps.
+* The heightmaps are read on the CPU by the terrain and are left as they are.
+* Usage : texture_bake [--format auto|bc1|bc3|bc5|rgba] [--hq] [directories or images...]
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+#include "../utils/ktx.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Encode one RGBA level in 'format', the blocks crossing the border repeat the last row and column **/
+static std::vector<unsigned char> encode_level(const unsigned char* rgba, int width, int height, uint32_t format, int channels, int mode){
+	std::vector<unsigned char> out(ktx_level_size(format, channels, width, height));
+	uint32_t block_size = ktx_block_size(format);
+	if (!block_size){
+		size_t row = out.size() / height;
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				for (int c = 0; c < channels; c++) out[y * row + x * channels + c] = rgba[((size_t)y * width + x) * 4 + c];
+		return out;
+	}
+	int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	unsigned char block[16 * 4], rg[16 * 2];
+	for (int by = 0; by < blocks_y; by++){
+		for (int bx = 0; bx < blocks_x; bx++){
+			for (int i = 0; i < 16; i++){
+				int x = std::min(bx * 4 + i % 4, width - 1);
+				int y = std::min(by * 4 + i / 4, height - 1);
+				std::memcpy(block + i * 4, rgba + ((size_t)y * width + x) * 4, 4);
+				rg[i * 2] = block[i * 4];
+				rg[i * 2 + 1] = block[i * 4 + 1];
+			}
+			unsigned char* dest = &out[(by * blocks_x + bx) * block_size];
+			if (format == KTX_BC5) stb_compress_bc5_block(dest, rg);
+			else stb_compress_dxt_block(dest, block, format == KTX_BC3, mode);
+		}
+	}
+	return out;
+}
+
+/** Peak signal to noise ratio of the decoded level 0 against the source, over the channels kept by the format **/
+static double psnr(const unsigned char* a, const unsigned char* b, size_t texels, int channels){
+	double error = 0.0;
+	for (size_t i = 0; i < texels; i++)
+		for (int c = 0; c < channels; c++){
+			double d = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+			error += d * d;
+		}
+	error /= (double)texels * channels;
+	return error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / error) : 99.0;
+}
+
+static const char* format_name(uint32_t format){
+	return format == KTX_BC1 ? "BC1" : format == KTX_BC3 ? "BC3" : format == KTX_BC5 ? "BC5" : "RGBA";
+}
+
+int main(int argc, char* argv[]){
+	std::string forced = "auto";
+	int mode = STB_DXT_NORMAL;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "--format" && i + 1 < argc) forced = argv[++i];
+		else if (arg == "--hq") mode = STB_DXT_HIGHQUAL;
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) inputs = {PATH_TO_TEXTURE, PATH_TO_TEXTURE "/ground", PATH_TO_TEXTURE "/sky_box"};
+
+	std::vector<std::string> files;
+	for (const std::string& input : inputs){
+		if (has_extension(input, ".png") || has_extension(input, ".jpg")) { files.push_back(input); continue; }
+		for (const char* ext : {".png", ".jpg"}){
+			std::vector<std::string> found = list_directory(input, ext);
+			files.insert(files.end(), found.begin(), found.end());
+		}
+	}
+	if (files.empty()){
+		std::cout << "No image found" << std::endl;
+		return 1;
+	}
+
+	std::printf("%-24s %11s %6s %5s %10s %10s %10s %9s %9s %7s\n", "file", "size", "levels", "fmt", "source", "RGBA8+mips",
+	            "ktx", "stb ms", "ktx ms", "PSNR");
+	int failed = 0;
+	for (const std::string& file : files){
+		std::string name = file.substr(file.find_last_of('/') + 1);
+		bool data_texture = name.find("height") != std::string::npos || name.find("island") != std::string::npos;
+		if (forced == "auto" && data_texture) continue;
+
+		int64_t mtime;
+		uint64_t source_size;
+		int width, height, channels;
+		auto start = std::chrono::steady_clock::now();
+		unsigned char* pixels = stbi_load(file.c_str(), &width, &height, &channels, 4);
+		double stb_ms = elapsed_ms(start);
+		if (!pixels || !file_info(file.c_str(), mtime, source_size)){
+			std::cout << "Failed to load " << file << std::endl;
+			failed++;
+			continue;
+		}
+
+		bool alpha = false;
+		for (size_t i = 0; i < (size_t)width * height && channels == 4; i++) alpha |= pixels[i * 4 + 3] != 255;
+		uint32_t format = forced == "bc1" ? KTX_BC1 : forced == "bc3" ? KTX_BC3 : forced == "bc5" ? KTX_BC5 :
+		                  forced == "rgba" || name.find("normal") != std::string::npos ? 0 : alpha ? KTX_BC3 : KTX_BC1;
+		int kept_channels = format == 0 ? std::min(channels, 4) : 4;
+
+		// every mip level down to 1x1, each one resized from the previous one
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+		std::vector<unsigned char> source = level;
+		stbi_image_free(pixels);
+		int w = width, h = height;
+		size_t payload = 0;
+		while (true){
+			levels.push_back(encode_level(level.data(), w, h, format, kept_channels, mode));
+			payload += levels.back().size();
+			if (w == 1 && h == 1) break;
+			int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+			std::vector<unsigned char> next((size_t)nw * nh * 4);
+			stbir_resize_uint8(level.data(), w, h, 0, next.data(), nw, nh, 0, 4);
+			level.swap(next);
+			w = nw;
+			h = nh;
+		}
+
+		std::string out_path = replace_extension(file, ".ktx");
+		if (!write_ktx(out_path, format ? format : KTX_RGBA8, kept_channels, width, height, 1, levels, ktx_source_stamp(mtime, source_size))){
+			std::cout << "Failed to write " << out_path << std::endl;
+			failed++;
+			continue;
+		}
+
+		// read it back the way the runtime does and compare the first level with the source
+		start = std::chrono::steady_clock::now();
+		KtxImage image;
+		bool loaded = load_ktx(out_path.c_str(), image);
+		uint64_t touched = 0;
+		for (const KtxLevel& l : image.levels)
+			for (uint32_t i = 0; i < l.size; i += 4096) touched += l.data[i];
+		double ktx_ms = elapsed_ms(start);
+		volatile uint64_t sink = touched;
+		(void)sink;
+		if (!loaded){
+			std::cout << "Failed to read back " << out_path << std::endl;
+			failed++;
+			continue;
+		}
+		std::vector<unsigned char> decoded;
+		if (format) decompress_ktx_level(format, image.level(0), decoded);
+		else {
+			decoded.assign((size_t)width * height * 4, 255);
+			size_t row = image.level(0).size / height;
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					for (int c = 0; c < kept_channels; c++) decoded[((size_t)y * width + x) * 4 + c] = image.level(0).data[y * row + x * kept_channels + c];
+		}
+		int compared = format == KTX_BC5 ? 2 : format == KTX_BC3 || kept_channels == 4 ? 4 : 3;
+
+		char size[32];
+		std::snprintf(size, sizeof(size), "%dx%d", width, height);
+		std::printf("%-24s %11s %6d %5s %9.0fK %9.0fK %9.0fK %9.2f %9.2f %6.1fdB\n", name.c_str(), size, (int)levels.size(), format_name(format),
+		            source_size / 1024.0, width * height * 4 * 4 / 3 / 1024.0, payload / 1024.0, stb_ms, ktx_ms,
+		            psnr(source.data(), decoded.data(), (size_t)width * height, compared));
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/**
+* @brief This header file defines the uniform blocks shared by every shader (camera, shadow matrix and lights),
+* written once per frame into uniform buffers bound to fixed binding points
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstring>
+
+/** Binding point of each uniform block, the blocks of every program are bound to them after the link **/
+enum UniformBlockBinding {
+    BLOCK_FRAME = 0,
+    BLOCK_LIGHT = 1
+};
+
+/**
+ * @brief Content of the std140 block FrameData of the shaders :
+ * layout(std140) uniform FrameData { mat4 V; mat4 P; mat4 lightspace; vec3 u_view_pos; float time; };
+**/
+struct FrameData {
+    glm::mat4 V;
+    glm::mat4 P;
+    glm::mat4 lightspace;
+    glm::vec3 view_pos;
+    float time;
+};
+
+/**
+ * @brief Content of the std140 block LightData of the shaders, the strengths of the lights stay in each material :
+ * layout(std140) uniform LightData { vec3 light_pos; vec3 light_dir; };
+**/
+struct LightData {
+    // position of the point light
+    glm::vec3 light_pos;
+    float padding0 = 0.0f;
+    // direction of the directional light
+    glm::vec3 light_dir;
+    float padding1 = 0.0f;
+};
+
+static_assert(sizeof(FrameData) == 208, "FrameData doesn't follow the std140 layout");
+static_assert(sizeof(LightData) == 32, "LightData doesn't follow the std140 layout");
+
+/** Bind the uniform blocks declared by 'program' to their binding points **/
+inline void bind_uniform_blocks(GLuint program){
+    GLuint frame = glGetUniformBlockIndex(program, "FrameData");
+    if (frame != GL_INVALID_INDEX) glUniformBlockBinding(program, frame, BLOCK_FRAME);
+    GLuint light = glGetUniformBlockIndex(program, "LightData");
+    if (light != GL_INVALID_INDEX) glUniformBlockBinding(program, light, BLOCK_LIGHT);
+}
+
+/**
+ * @brief Uniform buffers of the blocks, created by the first call on the OpenGL thread
+**/
+class UniformBlocks{
+public:
+    static UniformBlocks& get(){
+        static UniformBlocks blocks;
+        return blocks;
+    }
+
+    /** Write the camera and shadow data of the frame, before the first draw of the frame **/
+    void update_frame(const FrameData& data){
+        glBindBuffer(GL_UNIFORM_BUFFER, frame_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+    }
+
+    /** Write the lights, nothing is sent if they didn't move **/
+    void update_lights(const LightData& data){
+        if (lights_known && std::memcmp(&lights, &data, sizeof(LightData)) == 0) return;
+        lights = data;
+        lights_known = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, light_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightData), &data);
+    }
+
+private:
+    UniformBlocks(){
+        frame_buffer = create(BLOCK_FRAME, sizeof(FrameData));
+        light_buffer = create(BLOCK_LIGHT, sizeof(LightData));
+    }
+
+    static GLuint create(GLuint binding, GLsizeiptr size){
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        return buffer;
+    }
+
+    GLuint frame_buffer = 0, light_buffer = 0;
+    LightData lights;
+    bool lights_known = false;
+};
+#endif
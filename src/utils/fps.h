@@ -12,6 +12,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <string>
 
 /**
 * @brief Class that handle the calculation of the frame rate and display it in the title's window
@@ -21,6 +22,8 @@ public:
     double prev = 0;
     int deltaFrame = 0;
     GLFWwindow* window = nullptr;
+    // counters of the frame shown after the frame rate (drawn and culled objects)
+    std::string stats;
 
     /** Constructor **/
     FPS(GLFWwindow* window){
@@ -36,6 +39,7 @@ public:
             const double fpsCount = (double)deltaFrame / deltaTime;
             deltaFrame = 0;
             std::string title = "Project - " + std::to_string(fpsCount) + " fps";
+            if (!stats.empty()) title += " - " + stats;
             glfwSetWindowTitle(window,title.c_str());
         }
         return deltaTime;
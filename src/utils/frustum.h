@@ -0,0 +1,121 @@
+/**
+* @brief This header file defines the Frustum struct, the six planes of a view-projection matrix and the
+* bounding volume tests used to skip the objects outside of the view
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "./simd.h"
+
+/** Number of objects drawn and skipped by a pass, shown in the title with the frame rate **/
+struct CullingStats {
+    int drawn = 0;
+    int culled = 0;
+
+    void reset(){
+        drawn = culled = 0;
+    }
+
+    /** Count an object, returns 'visible' so that it can wrap the test **/
+    bool count(bool visible){
+        (visible ? drawn : culled)++;
+        return visible;
+    }
+};
+
+/**
+ * @brief The six planes (left, right, bottom, top, near, far) of the volume seen through a view-projection matrix,
+ * pointing inside and normalized so that the plane equation gives a distance. Works for the perspective of the
+ * camera as well as the orthographic projection of the light
+**/
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum(){
+        // without a matrix nothing is culled
+        for (glm::vec4& plane : planes) plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    /** Extract the planes of 'VP' (Gribb and Hartmann), a point is inside if it's in front of the six planes **/
+    explicit Frustum(const glm::mat4& VP){
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) rows[i] = glm::vec4(VP[0][i], VP[1][i], VP[2][i], VP[3][i]);
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[3] + rows[2];
+        planes[5] = rows[3] - rows[2];
+        for (glm::vec4& plane : planes) plane /= glm::length(glm::vec3(plane));
+    }
+
+    /** True if the sphere is at least partly inside **/
+    bool intersects(glm::vec3 center, float radius) const {
+        for (const glm::vec4& plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        return true;
+    }
+
+    /** True if the box [bounds_min, bounds_max] is at least partly inside, tested with its corner the most inside each plane **/
+    bool intersects(glm::vec3 bounds_min, glm::vec3 bounds_max) const {
+        for (const glm::vec4& plane : planes){
+            glm::vec3 corner(plane.x >= 0.0f ? bounds_max.x : bounds_min.x,
+                             plane.y >= 0.0f ? bounds_max.y : bounds_min.y,
+                             plane.z >= 0.0f ? bounds_max.z : bounds_min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Test 'count' spheres given as one array per component, visible[i] is set to 1 if the sphere i is at least
+     * partly inside. Four spheres are tested against a plane at once
+    **/
+    void intersects(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const {
+        size_t i = 0;
+#if defined(SIMD_SSE)
+        for (; i + 4 <= count; i += 4){
+            __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+            __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+            __m128 outside = _mm_setzero_ps();
+            for (const glm::vec4& plane : planes){
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                      _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, r));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for (int lane = 0; lane < 4; lane++) visible[i + lane] = (mask >> lane & 1) ? 0 : 1;
+        }
+#elif defined(SIMD_NEON)
+        for (; i + 4 <= count; i += 4){
+            float32x4_t cx = vld1q_f32(x + i), cy = vld1q_f32(y + i), cz = vld1q_f32(z + i);
+            float32x4_t r = vnegq_f32(vld1q_f32(radius + i));
+            uint32x4_t outside = vdupq_n_u32(0);
+            for (const glm::vec4& plane : planes){
+                float32x4_t d = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(plane.w), cx, plane.x), cy, plane.y), cz, plane.z);
+                outside = vorrq_u32(outside, vcltq_f32(d, r));
+            }
+            uint32_t lanes[4];
+            vst1q_u32(lanes, outside);
+            for (int lane = 0; lane < 4; lane++) visible[i + lane] = lanes[lane] ? 0 : 1;
+        }
+#endif
+        for (; i < count; i++) visible[i] = intersects(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+    }
+};
+
+/** World bounding sphere of the local box [bounds_min, bounds_max] placed by 'model', the scale enlarges the radius **/
+inline void bounding_sphere(const glm::mat4& model, glm::vec3 bounds_min, glm::vec3 bounds_max, glm::vec3& center, float& radius){
+    center = glm::vec3(model * glm::vec4((bounds_min + bounds_max) * 0.5f, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    radius = glm::length(bounds_max - bounds_min) * 0.5f * scale;
+}
+#endif
@@ -0,0 +1,179 @@
+/**
+* @brief This header file defines the worker pool decoding the assets and the queue of the uploads run on the OpenGL thread
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+// Time given every frame to the uploads waiting for the OpenGL thread (in seconds)
+const double UPLOAD_BUDGET = 0.004;
+
+/**
+ * @brief Queue of the OpenGL calls prepared by the workers. Only the thread owning the context drains it
+**/
+class UploadQueue{
+public:
+    static UploadQueue& get(){
+        static UploadQueue queue;
+        return queue;
+    }
+
+    /** Queue an upload, can be called from any thread **/
+    void push(std::function<void()> upload){
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.push_back(std::move(upload));
+    }
+
+    /** Run the queued uploads until 'budget' seconds are spent, at least one is run so that the queue always progresses.
+     *  Returns the number of uploads run
+    **/
+    int drain(double budget){
+        auto start = std::chrono::steady_clock::now();
+        int count = 0;
+        while (true){
+            std::function<void()> upload;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (uploads.empty()) break;
+                upload = std::move(uploads.front());
+                uploads.pop_front();
+            }
+            upload();
+            count++;
+            std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+            if (spent.count() >= budget) break;
+        }
+        return count;
+    }
+
+    bool empty(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return uploads.empty();
+    }
+
+private:
+    UploadQueue(){}
+    std::mutex mutex;
+    std::deque<std::function<void()>> uploads;
+};
+
+/**
+ * @brief Pool of worker threads running the decoding and parsing jobs of the assets
+**/
+class JobSystem{
+public:
+    static JobSystem& get(){
+        static JobSystem jobs;
+        return jobs;
+    }
+
+    /** Run 'job' on one of the workers **/
+    void submit(std::function<void()> job){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            unfinished++;
+        }
+        wake.notify_one();
+    }
+
+    /** Run 'work' on a worker then queue 'upload' for the OpenGL thread **/
+    void submit(std::function<void()> work, std::function<void()> upload){
+        submit([work, upload](){
+            work();
+            UploadQueue::get().push(upload);
+        });
+    }
+
+    /** Block until every submitted job is done **/
+    void wait_idle(){
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this](){ return unfinished == 0; });
+    }
+
+    /** True while some jobs are waiting or running **/
+    bool busy(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return unfinished > 0;
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    ~JobSystem(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+private:
+    JobSystem(){
+        // the upload queue must outlive the workers that push into it
+        UploadQueue::get();
+        unsigned int count = std::thread::hardware_concurrency();
+        count = count > 2 ? count - 1 : 1;
+        for (unsigned int i = 0; i < count; i++) workers.emplace_back([this](){ run(); });
+    }
+
+    void run(){
+        while (true){
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this](){ return stopping || !jobs.empty(); });
+                if (stopping) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                unfinished--;
+            }
+            idle.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake, idle;
+    size_t unfinished = 0;
+    bool stopping = false;
+};
+
+/**
+ * @brief Number of resources of an asset that are not on the GPU yet. The copies of the asset share the counter
+ * so that an asset passed by value sees the uploads done after the copy
+**/
+class Residency{
+public:
+    Residency() : pending(std::make_shared<std::atomic<int>>(0)) {}
+
+    void add(int count = 1){ *pending += count; }
+    void done(){ (*pending)--; }
+    bool ready() const { return pending->load() == 0; }
+
+private:
+    std::shared_ptr<std::atomic<int>> pending;
+};
+#endif
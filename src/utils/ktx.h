@@ -0,0 +1,352 @@
+/**
+* @brief This header file defines the reading and writing of the baked ´.ktx´ textures (KTX 1.1 containers holding
+* every mip level) and the CPU decompression of their block-compressed payloads
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef KTX_H
+#define KTX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "./mapped_file.h"
+
+// OpenGL enums stored in the header, repeated here so that the tools don't need the OpenGL headers
+const uint32_t KTX_UNSIGNED_BYTE = 0x1401;
+const uint32_t KTX_RED = 0x1903;
+const uint32_t KTX_RG = 0x8227;
+const uint32_t KTX_RGB = 0x1907;
+const uint32_t KTX_RGBA = 0x1908;
+const uint32_t KTX_R8 = 0x8229;
+const uint32_t KTX_RG8 = 0x822B;
+const uint32_t KTX_RGB8 = 0x8051;
+const uint32_t KTX_RGBA8 = 0x8058;
+const uint32_t KTX_BC1 = 0x83F0;    // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+const uint32_t KTX_BC3 = 0x83F3;    // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+const uint32_t KTX_BC5 = 0x8DBD;    // GL_COMPRESSED_RG_RGTC2
+
+const unsigned char KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+// Key of the metadata linking a baked file to the image it was made from
+const char KTX_SOURCE_KEY[] = "VRsource";
+
+/**
+ * @brief Header of a KTX 1.1 file, followed by the key/value data and by the mip levels (largest first)
+**/
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t array_elements;
+    uint32_t faces;
+    uint32_t mip_levels;
+    uint32_t key_value_bytes;
+};
+
+/** One mip level of one face, it points either in the mapped file or in a buffer owned by the KtxImage **/
+struct KtxLevel {
+    int width = 0, height = 0;
+    const unsigned char* data = nullptr;
+    uint32_t size = 0;
+};
+
+/**
+ * @brief Baked texture, mapped in memory
+**/
+struct KtxImage {
+    KtxHeader header;
+    std::vector<KtxLevel> levels;           // level * faces + face
+    std::string source;                     // value of KTX_SOURCE_KEY
+    MappedFile mapping;
+    std::vector<std::vector<unsigned char>> owned;
+
+    bool compressed() const { return header.gl_type == 0; }
+    uint32_t face_count() const { return header.faces; }
+    uint32_t level_count() const { return header.mip_levels; }
+    const KtxLevel& level(uint32_t level, uint32_t face = 0) const { return levels[level * header.faces + face]; }
+
+    /** Make a level point to a new buffer owned by the image **/
+    void replace(uint32_t level, uint32_t face, std::vector<unsigned char>&& data){
+        owned.push_back(std::move(data));
+        KtxLevel& l = levels[level * header.faces + face];
+        l.data = owned.back().data();
+        l.size = (uint32_t)owned.back().size();
+    }
+};
+
+/** Size in bytes of a 4x4 block, 0 for an uncompressed format **/
+inline uint32_t ktx_block_size(uint32_t internal_format){
+    return internal_format == KTX_BC1 ? 8 : (internal_format == KTX_BC3 || internal_format == KTX_BC5) ? 16 : 0;
+}
+
+/** Number of channels of an uncompressed format **/
+inline int ktx_channels(uint32_t format){
+    return format == KTX_RED ? 1 : format == KTX_RG ? 2 : format == KTX_RGB ? 3 : 4;
+}
+
+/** Size of one level of 'width' x 'height' texels, the rows of uncompressed data are aligned on 4 bytes **/
+inline uint32_t ktx_level_size(uint32_t internal_format, int channels, int width, int height){
+    uint32_t block = ktx_block_size(internal_format);
+    if (block) return ((width + 3) / 4) * ((height + 3) / 4) * block;
+    return ((width * channels + 3) & ~3u) * height;
+}
+
+/** Parse a KTX file in place, returns false if it's not a KTX 1.1 file written with the native byte order **/
+inline bool parse_ktx(const char* begin, size_t size, KtxImage& image){
+    if (size < sizeof(KtxHeader)) return false;
+    std::memcpy(&image.header, begin, sizeof(KtxHeader));
+    const KtxHeader& h = image.header;
+    if (std::memcmp(h.identifier, KTX_IDENTIFIER, 12) != 0 || h.endianness != 0x04030201) return false;
+    if (h.pixel_depth > 1 || h.array_elements > 0 || (h.faces != 1 && h.faces != 6) || h.pixel_width == 0) return false;
+
+    const char* p = begin + sizeof(KtxHeader);
+    const char* end = begin + size;
+    const char* kv_end = p + h.key_value_bytes;
+    if (kv_end > end) return false;
+    while (p + 4 <= kv_end){
+        uint32_t bytes;
+        std::memcpy(&bytes, p, 4);
+        p += 4;
+        if (p + bytes > kv_end) return false;
+        if (std::strncmp(p, KTX_SOURCE_KEY, bytes) == 0 && bytes > sizeof(KTX_SOURCE_KEY)){
+            const char* value = p + sizeof(KTX_SOURCE_KEY);
+            image.source.assign(value, strnlen(value, p + bytes - value));
+        }
+        p += (bytes + 3) & ~3u;
+    }
+    p = kv_end;
+
+    uint32_t levels = std::max(1u, h.mip_levels);
+    image.header.mip_levels = levels;
+    int channels = ktx_channels(h.gl_format);
+    image.levels.clear();
+    for (uint32_t level = 0; level < levels; level++){
+        if (p + 4 > end) return false;
+        uint32_t image_size;
+        std::memcpy(&image_size, p, 4);
+        p += 4;
+        int width = std::max(1, (int)(h.pixel_width >> level));
+        int height = std::max(1, (int)(std::max(1u, h.pixel_height) >> level));
+        if (image_size != ktx_level_size(h.gl_internal_format, channels, width, height)) return false;
+        for (uint32_t face = 0; face < h.faces; face++){
+            if (p + image_size > end) return false;
+            KtxLevel l;
+            l.width = width;
+            l.height = height;
+            l.data = (const unsigned char*)p;
+            l.size = image_size;
+            image.levels.push_back(l);
+            p += (image_size + 3) & ~3u;
+        }
+    }
+    return true;
+}
+
+/** Map and parse a ´.ktx´ file **/
+inline bool load_ktx(const char* path, KtxImage& image){
+    if (!image.mapping.open(path)) return false;
+    return parse_ktx(image.mapping.data(), image.mapping.size(), image);
+}
+
+/** Value of KTX_SOURCE_KEY identifying the version of the source image **/
+inline std::string ktx_source_stamp(int64_t mtime, uint64_t size){
+    return std::to_string(mtime) + " " + std::to_string(size);
+}
+
+/**
+ * @brief Write a KTX file. 'levels' holds level * faces + face images already in the layout given by 'internal_format'
+**/
+inline bool write_ktx(const std::string& path, uint32_t internal_format, int channels, int width, int height, uint32_t faces,
+                      const std::vector<std::vector<unsigned char>>& levels, const std::string& source_stamp){
+    static const uint32_t formats[] = {KTX_RED, KTX_RG, KTX_RGB, KTX_RGBA};
+    static const uint32_t sized_formats[] = {KTX_R8, KTX_RG8, KTX_RGB8, KTX_RGBA8};
+    KtxHeader h;
+    std::memcpy(h.identifier, KTX_IDENTIFIER, 12);
+    h.endianness = 0x04030201;
+    bool compressed = ktx_block_size(internal_format) != 0;
+    h.gl_type = compressed ? 0 : KTX_UNSIGNED_BYTE;
+    h.gl_type_size = 1;
+    h.gl_format = compressed ? 0 : formats[channels - 1];
+    h.gl_internal_format = compressed ? internal_format : sized_formats[channels - 1];
+    h.gl_base_internal_format = internal_format == KTX_BC1 ? KTX_RGB : internal_format == KTX_BC3 ? KTX_RGBA :
+                                internal_format == KTX_BC5 ? KTX_RG : formats[channels - 1];
+    h.pixel_width = width;
+    h.pixel_height = height;
+    h.pixel_depth = 0;
+    h.array_elements = 0;
+    h.faces = faces;
+    h.mip_levels = (uint32_t)(levels.size() / faces);
+
+    // key/value pairs : the orientation of the rows (stb_image order, top row first) and the source of the file
+    std::vector<char> kv;
+    auto add_pair = [&kv](const std::string& key, const std::string& value){
+        uint32_t bytes = (uint32_t)(key.size() + 1 + value.size() + 1);
+        const char* b = (const char*)&bytes;
+        kv.insert(kv.end(), b, b + 4);
+        kv.insert(kv.end(), key.c_str(), key.c_str() + key.size() + 1);
+        kv.insert(kv.end(), value.c_str(), value.c_str() + value.size() + 1);
+        while (kv.size() % 4) kv.push_back(0);
+    };
+    add_pair("KTXorientation", "S=r,T=d");
+    add_pair(KTX_SOURCE_KEY, source_stamp);
+    h.key_value_bytes = (uint32_t)kv.size();
+
+    std::vector<char> file((const char*)&h, (const char*)&h + sizeof(h));
+    file.insert(file.end(), kv.begin(), kv.end());
+    for (uint32_t level = 0; level < h.mip_levels; level++){
+        uint32_t image_size = (uint32_t)levels[level * faces].size();
+        const char* b = (const char*)&image_size;
+        file.insert(file.end(), b, b + 4);
+        for (uint32_t face = 0; face < faces; face++){
+            const std::vector<unsigned char>& data = levels[level * faces + face];
+            file.insert(file.end(), data.begin(), data.end());
+            while (file.size() % 4) file.push_back(0);
+        }
+    }
+    return write_file_atomic(path, file.data(), file.size());
+}
+
+/** Decode the 4x4 RGB565 color part of a BC1/BC3 block into 'out' (16 RGBA texels) **/
+inline void decode_bc1_colors(const unsigned char* block, unsigned char* out, bool four_colors){
+    uint16_t c0 = block[0] | block[1] << 8;
+    uint16_t c1 = block[2] | block[3] << 8;
+    unsigned char palette[4][4];
+    auto expand = [](uint16_t c, unsigned char* rgb){
+        rgb[0] = (unsigned char)(((c >> 11) & 31) * 255 / 31);
+        rgb[1] = (unsigned char)(((c >> 5) & 63) * 255 / 63);
+        rgb[2] = (unsigned char)((c & 31) * 255 / 31);
+    };
+    expand(c0, palette[0]);
+    expand(c1, palette[1]);
+    // the BC1 levels are GL_COMPRESSED_RGB_S3TC_DXT1_EXT, without alpha the 4th color of the 3 colors mode is opaque black
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    if (four_colors || c0 > c1){
+        for (int k = 0; k < 3; k++){
+            palette[2][k] = (unsigned char)((2 * palette[0][k] + palette[1][k]) / 3);
+            palette[3][k] = (unsigned char)((palette[0][k] + 2 * palette[1][k]) / 3);
+        }
+    }
+    else {
+        for (int k = 0; k < 3; k++){
+            palette[2][k] = (unsigned char)((palette[0][k] + palette[1][k]) / 2);
+            palette[3][k] = 0;
+        }
+    }
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+    for (int i = 0; i < 16; i++) std::memcpy(out + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+}
+
+/** Decode a BC4 block (one channel) into 'out', writing every 'stride' bytes **/
+inline void decode_bc4_block(const unsigned char* block, unsigned char* out, int stride){
+    unsigned char a[8];
+    a[0] = block[0];
+    a[1] = block[1];
+    if (a[0] > a[1]){
+        for (int i = 1; i < 7; i++) a[i + 1] = (unsigned char)(((7 - i) * a[0] + i * a[1]) / 7);
+    }
+    else {
+        for (int i = 1; i < 5; i++) a[i + 1] = (unsigned char)(((5 - i) * a[0] + i * a[1]) / 5);
+        a[6] = 0;
+        a[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) indices |= (uint64_t)block[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++) out[i * stride] = a[(indices >> (3 * i)) & 7];
+}
+
+/**
+ * @brief Decompress a BC1, BC3 or BC5 level into RGBA8 rows (used when the driver can't sample the compressed format)
+**/
+inline void decompress_ktx_level(uint32_t internal_format, const KtxLevel& level, std::vector<unsigned char>& rgba){
+    int blocks_x = (level.width + 3) / 4, blocks_y = (level.height + 3) / 4;
+    uint32_t block_size = ktx_block_size(internal_format);
+    rgba.assign((size_t)level.width * level.height * 4, 255);
+    unsigned char texels[16 * 4];
+    for (int by = 0; by < blocks_y; by++){
+        for (int bx = 0; bx < blocks_x; bx++){
+            const unsigned char* block = level.data + (by * blocks_x + bx) * block_size;
+            if (internal_format == KTX_BC1) decode_bc1_colors(block, texels, false);
+            else if (internal_format == KTX_BC3){
+                decode_bc1_colors(block + 8, texels, true);
+                decode_bc4_block(block, texels + 3, 4);
+            }
+            else {
+                std::memset(texels, 0, sizeof(texels));
+                decode_bc4_block(block, texels, 4);
+                decode_bc4_block(block + 8, texels + 1, 4);
+                for (int i = 0; i < 16; i++) texels[i * 4 + 3] = 255;
+            }
+            // copy the texels of the block that lie inside the image
+            for (int y = 0; y < 4 && by * 4 + y < level.height; y++){
+                int count = std::min(4, level.width - bx * 4);
+                std::memcpy(&rgba[(((size_t)by * 4 + y) * level.width + bx * 4) * 4], texels + y * 16, count * 4);
+            }
+        }
+    }
+}
+
+/** Reverse the rows 0..rows-1 of the 3 bits indices of a BC4 block **/
+inline void flip_bc4_block(unsigned char* block, int rows){
+    uint64_t indices = 0, flipped = 0;
+    for (int i = 0; i < 6; i++) indices |= (uint64_t)block[2 + i] << (8 * i);
+    flipped = indices;
+    for (int y = 0; y < rows; y++){
+        uint64_t row = (indices >> (12 * y)) & 0xfff;
+        flipped &= ~(0xfffull << (12 * (rows - 1 - y)));
+        flipped |= row << (12 * (rows - 1 - y));
+    }
+    for (int i = 0; i < 6; i++) block[2 + i] = (unsigned char)(flipped >> (8 * i));
+}
+
+/**
+ * @brief Flip a level upside down into 'out'. A compressed level is flipped block by block, which is only possible
+ * when its height is a multiple of 4 or smaller than 4. Returns false otherwise
+**/
+inline bool flip_ktx_level(uint32_t internal_format, const KtxLevel& level, std::vector<unsigned char>& out){
+    out.assign(level.data, level.data + level.size);
+    uint32_t block_size = ktx_block_size(internal_format);
+    if (!block_size){
+        size_t row = level.size / level.height;
+        for (int y = 0; y < level.height; y++)
+            std::memcpy(&out[y * row], level.data + (level.height - 1 - y) * row, row);
+        return true;
+    }
+    if (level.height > 4 && level.height % 4) return false;
+    int rows = std::min(4, level.height);
+    int blocks_x = (level.width + 3) / 4, blocks_y = (level.height + 3) / 4;
+    size_t block_row = (size_t)blocks_x * block_size;
+    for (int by = 0; by < blocks_y; by++){
+        unsigned char* dst = &out[by * block_row];
+        std::memcpy(dst, level.data + (blocks_y - 1 - by) * block_row, block_row);
+        for (int bx = 0; bx < blocks_x; bx++){
+            unsigned char* block = dst + bx * block_size;
+            unsigned char* color = internal_format == KTX_BC3 ? block + 8 : block;
+            if (internal_format != KTX_BC5){
+                // one byte of 2 bits indices per row
+                unsigned char indices[4];
+                std::memcpy(indices, color + 4, 4);
+                for (int y = 0; y < rows; y++) color[4 + y] = indices[rows - 1 - y];
+            }
+            if (internal_format == KTX_BC3) flip_bc4_block(block, rows);
+            if (internal_format == KTX_BC5){
+                flip_bc4_block(block, rows);
+                flip_bc4_block(block + 8, rows);
+            }
+        }
+    }
+    return true;
+}
+#endif
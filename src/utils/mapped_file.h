@@ -0,0 +1,227 @@
+/**
+* @brief This header file defines the MappedFile class and a few small file system helpers
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/**
+* @brief Class that maps a whole file read-only in memory and unmaps it when destroyed
+**/
+class MappedFile{
+public:
+    /** Constructor **/
+    MappedFile(){}
+
+    /** Map the file located at 'path' **/
+    MappedFile(const char* path){
+        open(path);
+    }
+
+    ~MappedFile(){
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** Map the file located at 'path', returns false if the file can't be opened **/
+    bool open(const char* path){
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        length = (size_t)file_size.QuadPart;
+        opened = true;
+        if (length == 0) return true;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) { close(); return false; }
+        bytes = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (bytes == nullptr) { close(); return false; }
+#else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(); return false; }
+        length = (size_t)st.st_size;
+        opened = true;
+        if (length == 0) return true;
+        void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) { close(); return false; }
+        bytes = (const char*) ptr;
+        // the file is read once from the start to the end
+        madvise(ptr, length, MADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    /** Unmap the file **/
+    void close(){
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap((void*) bytes, length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+        opened = false;
+    }
+
+    bool is_open() const { return opened; }
+    const char* data() const { return bytes; }
+    const char* end() const { return bytes + length; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+/** Retrieve the last modification time and the size of a file, returns false if the file doesn't exist **/
+inline bool file_info(const char* path, int64_t& mtime, uint64_t& size){
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+#endif
+    mtime = (int64_t)st.st_mtime;
+    size = (uint64_t)st.st_size;
+    return true;
+}
+
+/** Create the directory 'path' if it doesn't exist yet (its parent must exist), returns false if it can't be created **/
+inline bool make_directory(const std::string& path){
+#ifdef _WIN32
+    if (CreateDirectoryA(path.c_str(), NULL)) return true;
+    return GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) return S_ISDIR(st.st_mode);
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+/** Write 'size' bytes to 'path' through a temporary file so that a reader never sees a partially written file **/
+inline bool write_file_atomic(const std::string& path, const void* data, size_t size){
+    // a temporary file per thread, two workers may write the cache of the same file
+    std::string tmp_path = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write((const char*)data, size);
+        if (!out) return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0){
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** Overwrite the first 'size' bytes of the existing file 'path' in place, returns false if it can't be written **/
+inline bool overwrite_file_start(const std::string& path, const void* data, size_t size){
+    FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) return false;
+    bool written = std::fwrite(data, 1, size, file) == size;
+    return std::fclose(file) == 0 && written;
+}
+
+/** 64 bits FNV-1a hash of a block of memory **/
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull){
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/** Replace the extension of 'path' (or append one if there is none) **/
+inline std::string replace_extension(const std::string& path, const std::string& extension){
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + extension;
+    return path.substr(0, dot) + extension;
+}
+
+/** Return true if 'name' ends with 'extension' **/
+inline bool has_extension(const std::string& name, const std::string& extension){
+    return name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+/** List the files of the directory 'dir' ending with 'extension', sorted by name **/
+inline std::vector<std::string> list_directory(const std::string& dir, const std::string& extension){
+    std::vector<std::string> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA find_data;
+    HANDLE handle = FindFirstFileA((dir + "/*").c_str(), &find_data);
+    if (handle == INVALID_HANDLE_VALUE) return files;
+    do {
+        std::string name = find_data.cFileName;
+        if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && has_extension(name, extension))
+            files.push_back(dir + "/" + name);
+    } while (FindNextFileA(handle, &find_data));
+    FindClose(handle);
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) return files;
+    while (dirent* entry = readdir(handle)){
+        std::string name = entry->d_name;
+        if (name != "." && name != ".." && has_extension(name, extension))
+            files.push_back(dir + "/" + name);
+    }
+    closedir(handle);
+#endif
+    std::sort(files.begin(), files.end());
+    return files;
+}
+#endif
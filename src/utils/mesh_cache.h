@@ -0,0 +1,219 @@
+/**
+* @brief This header file defines the binary mesh cache written next to each ´.obj´ asset
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "./mapped_file.h"
+#include "./obj_loader.h"
+#include "./mesh_optimizer.h"
+
+// Bump the version each time the layout of the header or of the payload changes, older files are then rebuilt
+const uint32_t MESH_CACHE_VERSION = 2;
+const char MESH_CACHE_MAGIC[4] = {'V', 'R', 'M', 'B'};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed to be uploaded as is");
+
+/**
+ * @brief Header of a ´.mesh´ file. It's followed by 'vertex_count' Vertex and 'index_count' indices of 'index_size' bytes
+**/
+struct MeshHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;       // FNV-1a of the ´.obj´ content
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size;        // 2 or 4 bytes, 0 for a non-indexed triangle soup
+    uint32_t reserved;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+/**
+ * @brief CPU side mesh. The data either lives in the vectors (parsed from the ´.obj´) or in a mapped ´.mesh´ file
+**/
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint16_t> short_indices;
+    MappedFile mapping;
+
+    const Vertex* vertex_data = nullptr;
+    uint32_t vertex_count = 0;
+    const void* index_data = nullptr;
+    uint32_t index_count = 0;
+    uint32_t index_size = 0;
+    glm::vec3 bounds_min = glm::vec3(0.0f);
+    glm::vec3 bounds_max = glm::vec3(0.0f);
+
+    /** Point the views to the owned vectors, the indices are stored on 16 bits when the vertex count allows it **/
+    void use_owned_data(){
+        vertex_data = vertices.data();
+        vertex_count = (uint32_t)vertices.size();
+        index_count = (uint32_t)indices.size();
+        if (!indices.empty() && vertices.size() <= 0xffff){
+            short_indices.assign(indices.begin(), indices.end());
+            indices.clear();
+            indices.shrink_to_fit();
+        }
+        index_data = !short_indices.empty() ? (const void*)short_indices.data() : !indices.empty() ? (const void*)indices.data() : nullptr;
+        index_size = !short_indices.empty() ? sizeof(uint16_t) : !indices.empty() ? sizeof(uint32_t) : 0;
+    }
+
+    /** Compute the axis aligned bounding box of the vertices **/
+    void compute_bounds(){
+        vertex_bounds(vertex_data, vertex_count, bounds_min, bounds_max);
+    }
+};
+
+/** Path of the cache file associated to an ´.obj´ file **/
+inline std::string mesh_cache_path(const char* path){
+    return replace_extension(path, ".mesh");
+}
+
+/** Map a ´.mesh´ file and check it against the source file, returns false if it's missing or stale **/
+inline bool load_mesh_cache(const char* source_path, MeshData& mesh){
+    int64_t mtime;
+    uint64_t size;
+    if (!file_info(source_path, mtime, size)) return false;
+
+    if (!mesh.mapping.open(mesh_cache_path(source_path).c_str())) return false;
+    if (mesh.mapping.size() < sizeof(MeshHeader)) { mesh.mapping.close(); return false; }
+
+    MeshHeader header;
+    std::memcpy(&header, mesh.mapping.data(), sizeof(MeshHeader));
+    size_t expected = sizeof(MeshHeader) + (size_t)header.vertex_count * sizeof(Vertex) + (size_t)header.index_count * header.index_size;
+    bool valid = std::memcmp(header.magic, MESH_CACHE_MAGIC, 4) == 0 && header.version == MESH_CACHE_VERSION
+              && header.source_size == size && mesh.mapping.size() == expected;
+    // a different modification time alone doesn't invalidate the cache if the content is the same
+    if (valid && header.source_mtime != mtime){
+        MappedFile source(source_path);
+        valid = source.is_open() && hash_bytes(source.data(), source.size()) == header.source_hash;
+        // the new time is recorded so that the next runs skip the hash, the cache stays valid if it can't be
+        if (valid){
+            header.source_mtime = mtime;
+            overwrite_file_start(mesh_cache_path(source_path), &header, sizeof(MeshHeader));
+        }
+    }
+    if (!valid) { mesh.mapping.close(); return false; }
+
+    const char* payload = mesh.mapping.data() + sizeof(MeshHeader);
+    mesh.vertex_data = (const Vertex*) payload;
+    mesh.vertex_count = header.vertex_count;
+    mesh.index_data = header.index_count ? payload + (size_t)header.vertex_count * sizeof(Vertex) : nullptr;
+    mesh.index_count = header.index_count;
+    mesh.index_size = header.index_size;
+    mesh.bounds_min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+    mesh.bounds_max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+    return true;
+}
+
+/** Write the ´.mesh´ file of 'mesh' next to its source file, returns false if it can't be written **/
+inline bool write_mesh_cache(const char* source_path, const MeshData& mesh, uint64_t source_hash){
+    int64_t mtime;
+    uint64_t size;
+    if (!file_info(source_path, mtime, size)) return false;
+
+    MeshHeader header;
+    std::memset(&header, 0, sizeof(MeshHeader));
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.source_hash = source_hash;
+    header.source_mtime = mtime;
+    header.source_size = size;
+    header.vertex_count = mesh.vertex_count;
+    header.index_count = mesh.index_count;
+    header.index_size = mesh.index_size;
+    for (int i = 0; i < 3; i++){
+        header.bounds_min[i] = mesh.bounds_min[i];
+        header.bounds_max[i] = mesh.bounds_max[i];
+    }
+
+    size_t vertex_bytes = (size_t)mesh.vertex_count * sizeof(Vertex);
+    size_t index_bytes = (size_t)mesh.index_count * mesh.index_size;
+    std::vector<char> file(sizeof(MeshHeader) + vertex_bytes + index_bytes);
+    std::memcpy(file.data(), &header, sizeof(MeshHeader));
+    if (vertex_bytes) std::memcpy(file.data() + sizeof(MeshHeader), mesh.vertex_data, vertex_bytes);
+    if (index_bytes) std::memcpy(file.data() + sizeof(MeshHeader) + vertex_bytes, mesh.index_data, index_bytes);
+    return write_file_atomic(mesh_cache_path(source_path), file.data(), file.size());
+}
+
+/** Vertex counts and average cache miss ratios of a mesh before and after its optimization **/
+struct MeshBuildStats {
+    uint32_t soup_vertices = 0;
+    uint32_t unique_vertices = 0;
+    uint32_t triangles = 0;
+    float soup_acmr = 0.0f;
+    float indexed_acmr = 0.0f;
+    float optimized_acmr = 0.0f;
+};
+
+/**
+ * @brief Turn a triangle soup into a deduplicated vertex buffer and an index buffer whose triangles
+ * are ordered for the post-transform cache and whose vertices are ordered for the fetches
+**/
+inline void index_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, MeshBuildStats* stats = nullptr){
+    std::vector<Vertex> unique;
+    deduplicate_vertices(vertices, unique, indices);
+    if (stats){
+        stats->soup_vertices = (uint32_t)vertices.size();
+        stats->unique_vertices = (uint32_t)unique.size();
+        stats->triangles = (uint32_t)indices.size() / 3;
+        // a soup transforms every vertex of every triangle
+        stats->soup_acmr = indices.empty() ? 0.0f : 3.0f;
+        stats->indexed_acmr = compute_acmr(indices, (uint32_t)unique.size());
+    }
+    optimize_vertex_cache(indices, (uint32_t)unique.size());
+    optimize_vertex_fetch(unique, indices);
+    if (stats) stats->optimized_acmr = compute_acmr(indices, (uint32_t)unique.size());
+    vertices.swap(unique);
+}
+
+/** Parse the ´.obj´ file into an indexed 'mesh' and return the hash of its content through 'source_hash' **/
+inline bool build_mesh(const char* path, MeshData& mesh, uint64_t& source_hash, MeshBuildStats* stats = nullptr){
+    MappedFile source;
+    if (!source.open(path)){
+        std::cout << "ERROR::OBJ::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> textures;
+    std::vector<glm::vec3> normals;
+    int skipped = parse_obj(source.data(), source.end(), positions, textures, normals, mesh.vertices);
+    if (skipped) std::cout << "WARNING::OBJ::" << skipped << " faces with an invalid index were skipped in " << path << std::endl;
+    source_hash = hash_bytes(source.data(), source.size());
+    index_mesh(mesh.vertices, mesh.indices, stats);
+    mesh.use_owned_data();
+    mesh.compute_bounds();
+    return true;
+}
+
+/**
+ * @brief Load the mesh of an ´.obj´ file. The ´.mesh´ cache is mapped when it's up to date,
+ * otherwise the ´.obj´ is parsed and the cache is (re)written for the next run
+**/
+inline bool load_mesh(const char* path, MeshData& mesh, bool verbose = false){
+    if (load_mesh_cache(path, mesh)){
+        if (verbose) std::cout << "Mapped mesh cache of " << path << std::endl;
+        return true;
+    }
+    uint64_t source_hash;
+    if (!build_mesh(path, mesh, source_hash)) return false;
+    if (!write_mesh_cache(path, mesh, source_hash) && verbose)
+        std::cout << "WARNING::MESH::Could not write the cache of " << path << std::endl;
+    return true;
+}
+#endif
@@ -0,0 +1,196 @@
+/**
+* @brief This header file defines the functions turning a triangle soup into an indexed mesh optimized for the GPU caches
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include "./obj_loader.h"
+#include "./mapped_file.h"
+
+// Size of the FIFO post-transform cache used to measure the ACMR
+const int ACMR_CACHE_SIZE = 16;
+// Size of the LRU cache modelled by the vertex cache optimizer
+const int OPTIMIZER_CACHE_SIZE = 32;
+
+/**
+ * @brief Merge the identical (position, uv, normal) triplets of a triangle soup.
+ * Fills 'unique' with one copy of each vertex and 'indices' with one index per vertex of the soup
+**/
+inline void deduplicate_vertices(const std::vector<Vertex>& soup, std::vector<Vertex>& unique, std::vector<uint32_t>& indices){
+    struct VertexHash {
+        size_t operator()(const Vertex& v) const { return (size_t)hash_bytes(&v, sizeof(Vertex)); }
+    };
+    struct VertexEqual {
+        bool operator()(const Vertex& a, const Vertex& b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+    };
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> lookup;
+    lookup.reserve(soup.size());
+    unique.clear();
+    indices.clear();
+    indices.reserve(soup.size());
+    for (const Vertex& v : soup){
+        auto inserted = lookup.insert(std::make_pair(v, (uint32_t)unique.size()));
+        if (inserted.second) unique.push_back(v);
+        indices.push_back(inserted.first->second);
+    }
+}
+
+/**
+ * @brief Average cache miss ratio (transformed vertices per triangle) of an index buffer
+ * for a FIFO post-transform cache of 'cache_size' entries. 3.0 is the worst case, ~0.5 the best for regular meshes
+**/
+inline float compute_acmr(const std::vector<uint32_t>& indices, uint32_t vertex_count, int cache_size = ACMR_CACHE_SIZE){
+    if (indices.size() < 3) return 0.0f;
+    // timestamp at which each vertex entered the cache, a vertex is a hit if it entered less than 'cache_size' misses ago
+    std::vector<uint32_t> entered(vertex_count, 0);
+    uint32_t misses = 0;
+    for (uint32_t index : indices){
+        if (entered[index] == 0 || misses - entered[index] + 1 > (uint32_t)cache_size){
+            misses++;
+            entered[index] = misses;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+/**
+ * @brief Reorder the triangles to reuse the post-transform vertex cache as much as possible
+ * (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation")
+**/
+inline void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count){
+    const uint32_t triangle_count = (uint32_t)indices.size() / 3;
+    if (triangle_count == 0) return;
+
+    auto vertex_score = [](int cache_position, uint32_t remaining) -> float {
+        if (remaining == 0) return -1.0f;
+        float score = 0.0f;
+        if (cache_position >= 0){
+            // the last triangle's vertices get a fixed score so that its neighbours are not favoured over the rest of the cache
+            if (cache_position < 3) score = 0.75f;
+            else score = std::pow(1.0f - (float)(cache_position - 3) / (float)(OPTIMIZER_CACHE_SIZE - 3), 1.5f);
+        }
+        // favour the vertices with few remaining triangles to get rid of lone triangles early
+        return score + 2.0f * std::pow((float)remaining, -0.5f);
+    };
+
+    // triangles adjacent to each vertex, stored as a compressed list
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (uint32_t index : indices) remaining[index]++;
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangle_count; t++)
+        for (int k = 0; k < 3; k++) adjacency[filled[indices[t * 3 + k]]++] = t;
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) score[v] = vertex_score(-1, remaining[v]);
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<char> emitted(triangle_count, 0);
+    for (uint32_t t = 0; t < triangle_count; t++)
+        triangle_score[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache, next_cache;
+    cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+    next_cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+    // vertices of the emitted triangles, the restart points when the cache has nothing left to offer
+    std::vector<uint32_t> dead_end;
+    dead_end.reserve(indices.size());
+    uint32_t scan = 0;
+    int best = -1;
+
+    for (uint32_t emitted_count = 0; emitted_count < triangle_count; emitted_count++){
+        if (best < 0){
+            // nothing usable in the cache : the best triangle around the latest vertex that still has some, or the
+            // next triangle in input order. Each vertex is popped once and the scan only moves forward, so the whole
+            // optimization stays linear even for a mesh made of many separate pieces
+            float best_score = -1e30f;
+            while (best < 0 && !dead_end.empty()){
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                for (uint32_t a = 0; a < remaining[v]; a++){
+                    uint32_t t = adjacency[offsets[v] + a];
+                    if (triangle_score[t] > best_score) { best_score = triangle_score[t]; best = (int)t; }
+                }
+            }
+            if (best < 0){
+                while (emitted[scan]) scan++;
+                best = (int)scan;
+            }
+        }
+
+        const uint32_t* tri = &indices[best * 3];
+        emitted[best] = 1;
+        output.insert(output.end(), tri, tri + 3);
+        dead_end.insert(dead_end.end(), tri, tri + 3);
+
+        // push the vertices of the triangle at the front of the LRU cache
+        next_cache.assign(tri, tri + 3);
+        for (uint32_t v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next_cache.push_back(v);
+        for (int k = 0; k < 3; k++){
+            uint32_t v = tri[k];
+            // remove the triangle from the adjacency of its vertices
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            for (uint32_t* it = begin; it != end; ++it)
+                if (*it == (uint32_t)best) { *it = *(end - 1); break; }
+            remaining[v]--;
+        }
+
+        // rescore the vertices of the cache and the triangles using them
+        for (size_t i = 0; i < next_cache.size(); i++){
+            uint32_t v = next_cache[i];
+            cache_position[v] = i < (size_t)OPTIMIZER_CACHE_SIZE ? (int)i : -1;
+            float new_score = vertex_score(cache_position[v], remaining[v]);
+            float delta = new_score - score[v];
+            score[v] = new_score;
+            for (uint32_t a = 0; a < remaining[v]; a++) triangle_score[adjacency[offsets[v] + a]] += delta;
+        }
+        if (next_cache.size() > (size_t)OPTIMIZER_CACHE_SIZE) next_cache.resize(OPTIMIZER_CACHE_SIZE);
+        cache.swap(next_cache);
+
+        // the next triangle is the best one adjacent to a cached vertex
+        best = -1;
+        float best_score = -1e30f;
+        for (uint32_t v : cache){
+            for (uint32_t a = 0; a < remaining[v]; a++){
+                uint32_t t = adjacency[offsets[v] + a];
+                if (triangle_score[t] > best_score) { best_score = triangle_score[t]; best = (int)t; }
+            }
+        }
+    }
+    indices.swap(output);
+}
+
+/**
+ * @brief Reorder the vertices in the order of their first use by the index buffer so that the vertex fetches are sequential
+**/
+inline void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+    const uint32_t unused = 0xffffffffu;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (uint32_t& index : indices){
+        if (remap[index] == unused){
+            remap[index] = (uint32_t)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+#endif
@@ -0,0 +1,230 @@
+/**
+* @brief This header file defines the in place ´.obj´ loader used by the Object class
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "./mapped_file.h"
+
+
+/**The struct that defines a vertex**/
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec2 Texture;
+	glm::vec3 Normal;
+};
+
+/** Compute the axis aligned bounding box of 'count' vertices **/
+inline void vertex_bounds(const Vertex* vertices, size_t count, glm::vec3& bounds_min, glm::vec3& bounds_max){
+    bounds_min = glm::vec3(0.0f);
+    bounds_max = glm::vec3(0.0f);
+    for (size_t i = 0; i < count; i++){
+        bounds_min = i ? glm::min(bounds_min, vertices[i].Position) : vertices[i].Position;
+        bounds_max = i ? glm::max(bounds_max, vertices[i].Position) : vertices[i].Position;
+    }
+}
+
+/**
+ * @brief Scanner that tokenizes a memory block in place. It never allocates and never reads past 'end'
+**/
+struct ObjScanner{
+    const char* p;
+    const char* end;
+
+    bool at_end() const { return p >= end; }
+
+    /** Skip the spaces and tabulations of the current line **/
+    void skip_blank(){
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    }
+
+    /** Move to the first character of the next line **/
+    void next_line(){
+        while (p < end && *p != '\n') p++;
+        if (p < end) p++;
+    }
+
+    bool end_of_line() const {
+        return p >= end || *p == '\n' || *p == '#';
+    }
+
+    /** Parse a signed integer, returns false if there is no digit at the current position **/
+    bool parse_int(long& value){
+        const char* q = p;
+        bool negative = false;
+        if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+        if (q >= end || *q < '0' || *q > '9') return false;
+        long v = 0;
+        while (q < end && *q >= '0' && *q <= '9') v = v * 10 + (*q++ - '0');
+        value = negative ? -v : v;
+        p = q;
+        return true;
+    }
+
+    /** Parse a decimal float with an optional exponent, returns false if there is no number at the current position **/
+    bool parse_float(float& value){
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char* q = p;
+        bool negative = false;
+        if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+
+        // accumulate up to 19 significant digits in an integer mantissa
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        while (q < end && *q >= '0' && *q <= '9'){
+            if (digits < 19) { mantissa = mantissa * 10 + (*q - '0'); if (mantissa) digits++; }
+            else exponent++;
+            q++; any = true;
+        }
+        if (q < end && *q == '.'){
+            q++;
+            while (q < end && *q >= '0' && *q <= '9'){
+                if (digits < 19) { mantissa = mantissa * 10 + (*q - '0'); if (mantissa) digits++; exponent--; }
+                q++; any = true;
+            }
+        }
+        if (!any) return false;
+        if (q < end && (*q == 'e' || *q == 'E')){
+            const char* e = q + 1;
+            bool exp_negative = false;
+            if (e < end && (*e == '-' || *e == '+')) exp_negative = *e++ == '-';
+            if (e < end && *e >= '0' && *e <= '9'){
+                int exp_value = 0;
+                while (e < end && *e >= '0' && *e <= '9') { if (exp_value < 1000) exp_value = exp_value * 10 + (*e - '0'); e++; }
+                exponent += exp_negative ? -exp_value : exp_value;
+                q = e;
+            }
+        }
+
+        double v = (double) mantissa;
+        while (exponent > 22) { v *= 1e22; exponent -= 22; }
+        while (exponent < -22) { v /= 1e22; exponent += 22; }
+        v = exponent >= 0 ? v * powers[exponent] : v / powers[-exponent];
+        value = (float)(negative ? -v : v);
+        p = q;
+        return true;
+    }
+
+    /** Parse up to 'n' floats of the current line, the missing components are left untouched **/
+    void parse_floats(float* out, int n){
+        for (int i = 0; i < n; i++){
+            skip_blank();
+            if (!parse_float(out[i])) return;
+        }
+    }
+};
+
+/**
+ * @brief Parse the content of an ´.obj´ file that lies in [begin, end).
+ * Supports the 'v', 'vt', 'vn' and 'f' statements with the 'v', 'v/vt', 'v//vn' and 'v/vt/vn' face formats,
+ * negative (relative) indices and polygons of any size that are triangulated as a fan.
+ * Returns the number of faces that were skipped because of an invalid index.
+**/
+inline int parse_obj(const char* begin, const char* end, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& textures,
+                     std::vector<glm::vec3>& normals, std::vector<Vertex>& vertices){
+    ObjScanner s = {begin, end};
+    int skipped = 0;
+
+    // resolve an obj index (1 based or negative) into a 0 based index, returns -1 if it's out of range
+    auto resolve = [](long index, size_t count) -> long {
+        long i = index > 0 ? index - 1 : (long)count + index;
+        return (index == 0 || i < 0 || i >= (long)count) ? -1 : i;
+    };
+
+    while (!s.at_end()){
+        s.skip_blank();
+        if (s.end_of_line()) { s.next_line(); continue; }
+        const char* keyword = s.p;
+
+        if (keyword[0] == 'v' && keyword + 1 < end && (keyword[1] == ' ' || keyword[1] == '\t')){
+            s.p += 1;
+            glm::vec3 v(0.0f);
+            s.parse_floats(&v.x, 3);
+            positions.push_back(v);
+        }
+        else if (keyword[0] == 'v' && keyword + 2 < end && keyword[1] == 'n' && (keyword[2] == ' ' || keyword[2] == '\t')){
+            s.p += 2;
+            glm::vec3 n(0.0f);
+            s.parse_floats(&n.x, 3);
+            normals.push_back(n);
+        }
+        else if (keyword[0] == 'v' && keyword + 2 < end && keyword[1] == 't' && (keyword[2] == ' ' || keyword[2] == '\t')){
+            s.p += 2;
+            glm::vec2 t(0.0f);
+            s.parse_floats(&t.x, 2);
+            textures.push_back(t);
+        }
+        else if (keyword[0] == 'f' && keyword + 1 < end && (keyword[1] == ' ' || keyword[1] == '\t')){
+            s.p += 1;
+            size_t face_start = vertices.size();
+            Vertex first, previous;
+            int corners = 0;
+            bool valid = true;
+            while (true){
+                s.skip_blank();
+                long p = 0, t = 0, n = 0;
+                if (!s.parse_int(p)) break;
+                if (s.p < end && *s.p == '/'){
+                    s.p++;
+                    s.parse_int(t);
+                    if (s.p < end && *s.p == '/'){
+                        s.p++;
+                        s.parse_int(n);
+                    }
+                }
+                long pi = resolve(p, positions.size());
+                long ti = t ? resolve(t, textures.size()) : 0;
+                long ni = n ? resolve(n, normals.size()) : 0;
+                if (pi < 0 || ti < 0 || ni < 0) { valid = false; break; }
+
+                Vertex v;
+                v.Position = positions[pi];
+                v.Texture = t ? textures[ti] : glm::vec2(0.0f);
+                v.Normal = n ? normals[ni] : glm::vec3(0.0f);
+
+                // fan triangulation : (first, previous, current) for every corner after the second one
+                if (corners == 0) first = v;
+                else if (corners >= 2){
+                    vertices.push_back(first);
+                    vertices.push_back(previous);
+                    vertices.push_back(v);
+                }
+                previous = v;
+                corners++;
+            }
+            if (!valid){
+                vertices.resize(face_start);
+                skipped++;
+            }
+        }
+        s.next_line();
+    }
+    return skipped;
+}
+
+/**
+ * @brief Memory map an ´.obj´ file and parse it in place, returns false if the file can't be opened
+**/
+inline bool load_obj(const char* path, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& textures,
+                     std::vector<glm::vec3>& normals, std::vector<Vertex>& vertices){
+    MappedFile file;
+    if (!file.open(path)){
+        std::cout << "ERROR::OBJ::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    int skipped = parse_obj(file.data(), file.end(), positions, textures, normals, vertices);
+    if (skipped) std::cout << "WARNING::OBJ::" << skipped << " faces with an invalid index were skipped in " << path << std::endl;
+    return true;
+}
+#endif
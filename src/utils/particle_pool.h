@@ -0,0 +1,213 @@
+/**
+* @brief This header file defines the structure-of-arrays storage of the CPU particles and its vectorized update kernel
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "./simd.h"
+
+/** Small wrappers over the vector registers so that the kernel is written once for every instruction set **/
+namespace particle_simd {
+#if defined(SIMD_AVX)
+    typedef __m256 Lane;
+    const unsigned WIDTH = 8;
+    inline Lane load(const float* p){ return _mm256_loadu_ps(p); }
+    inline void store(float* p, Lane v){ _mm256_storeu_ps(p, v); }
+    inline Lane splat(float v){ return _mm256_set1_ps(v); }
+    inline Lane add(Lane a, Lane b){ return _mm256_add_ps(a, b); }
+    inline Lane sub(Lane a, Lane b){ return _mm256_sub_ps(a, b); }
+    inline Lane mul(Lane a, Lane b){ return _mm256_mul_ps(a, b); }
+    inline const char* name(){ return "avx"; }
+#elif defined(SIMD_SSE)
+    typedef __m128 Lane;
+    const unsigned WIDTH = 4;
+    inline Lane load(const float* p){ return _mm_loadu_ps(p); }
+    inline void store(float* p, Lane v){ _mm_storeu_ps(p, v); }
+    inline Lane splat(float v){ return _mm_set1_ps(v); }
+    inline Lane add(Lane a, Lane b){ return _mm_add_ps(a, b); }
+    inline Lane sub(Lane a, Lane b){ return _mm_sub_ps(a, b); }
+    inline Lane mul(Lane a, Lane b){ return _mm_mul_ps(a, b); }
+    inline const char* name(){ return "sse"; }
+#elif defined(SIMD_NEON)
+    typedef float32x4_t Lane;
+    const unsigned WIDTH = 4;
+    inline Lane load(const float* p){ return vld1q_f32(p); }
+    inline void store(float* p, Lane v){ vst1q_f32(p, v); }
+    inline Lane splat(float v){ return vdupq_n_f32(v); }
+    inline Lane add(Lane a, Lane b){ return vaddq_f32(a, b); }
+    inline Lane sub(Lane a, Lane b){ return vsubq_f32(a, b); }
+    inline Lane mul(Lane a, Lane b){ return vmulq_f32(a, b); }
+    inline const char* name(){ return "neon"; }
+#else
+    typedef float Lane;
+    const unsigned WIDTH = 1;
+    inline Lane load(const float* p){ return *p; }
+    inline void store(float* p, Lane v){ *p = v; }
+    inline Lane splat(float v){ return v; }
+    inline Lane add(Lane a, Lane b){ return a + b; }
+    inline Lane sub(Lane a, Lane b){ return a - b; }
+    inline Lane mul(Lane a, Lane b){ return a * b; }
+    inline const char* name(){ return "scalar"; }
+#endif
+}
+
+/** xorshift32 generator, a few instructions per number instead of a call to rand() and its shared state **/
+struct ParticleRandom {
+    uint32_t state;
+
+    explicit ParticleRandom(uint32_t seed = 0x9e3779b9u) : state(seed ? seed : 0x9e3779b9u) {}
+
+    uint32_t next(){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /** Uniform value in [0, 1) **/
+    float uniform(){
+        return (float)(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /** Uniform value in [low, high) **/
+    float uniform(float low, float high){
+        return low + (high - low) * uniform();
+    }
+};
+
+/**
+ * @brief Particles stored as one array per component. The live particles are always the first size() slots :
+ * a new particle takes the slot after the last one and a dead particle is replaced by the last one, so spawning
+ * and killing are O(1) and the update never walks over dead slots. The arrays are padded to a whole number of
+ * vector registers so that the kernel has no scalar tail
+**/
+class ParticlePool{
+public:
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> r, g, b, a;
+    std::vector<float> life;
+    // alpha lost per second by a live particle
+    float fade = 2.5f;
+
+    ParticlePool(unsigned int capacity = 0){
+        reserve(capacity);
+    }
+
+    /** Room for 'capacity' particles, the live particles are kept **/
+    void reserve(unsigned int capacity){
+        limit = capacity;
+        if (count > limit) count = limit;
+        size_t padded = ((size_t)capacity + particle_simd::WIDTH - 1) / particle_simd::WIDTH * particle_simd::WIDTH;
+        for (std::vector<float>* component : components()) component->resize(padded, 0.0f);
+    }
+
+    unsigned int size() const {
+        return count;
+    }
+
+    unsigned int capacity() const {
+        return limit;
+    }
+
+    void clear(){
+        count = 0;
+    }
+
+    /**
+     * Slot of a new particle. When the pool is full the slots are taken back in turn, like the previous
+     * implementation overriding a live particle. The slot isn't the oldest particle, the removal of the dead ones
+     * moves the particles. Returns -1 for a pool without capacity
+    **/
+    int spawn(){
+        if (limit == 0) return -1;
+        if (count < limit) return (int)count++;
+        overwrite = (overwrite + 1) % limit;
+        return (int)overwrite;
+    }
+
+    void set(unsigned int i, glm::vec3 position, glm::vec3 velocity, glm::vec4 color, float lifetime){
+        px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+        vx[i] = velocity.x; vy[i] = velocity.y; vz[i] = velocity.z;
+        r[i] = color.r; g[i] = color.g; b[i] = color.b; a[i] = color.a;
+        life[i] = lifetime;
+    }
+
+    glm::vec3 position(unsigned int i) const {
+        return glm::vec3(px[i], py[i], pz[i]);
+    }
+
+    glm::vec4 color(unsigned int i) const {
+        return glm::vec4(r[i], g[i], b[i], a[i]);
+    }
+
+    /** Age the particles by 'dt', move and fade them, then remove the dead ones **/
+    void update(float dt){
+        integrate(dt);
+        compact();
+    }
+
+    /** Vectorized integrate and fade of the live particles, the padding up to the next register is updated as well **/
+    void integrate(float dt){
+        using namespace particle_simd;
+        const Lane step = splat(dt);
+        const Lane faded = splat(dt * fade);
+        unsigned int end = (count + WIDTH - 1) / WIDTH * WIDTH;
+        for (unsigned int i = 0; i < end; i += WIDTH){
+            store(&life[i], sub(load(&life[i]), step));
+            store(&px[i], add(load(&px[i]), mul(load(&vx[i]), step)));
+            store(&py[i], add(load(&py[i]), mul(load(&vy[i]), step)));
+            store(&pz[i], add(load(&pz[i]), mul(load(&vz[i]), step)));
+            store(&a[i], sub(load(&a[i]), faded));
+        }
+    }
+
+    /** Same as integrate() one particle at a time, the reference of the kernel **/
+    void integrate_scalar(float dt){
+        for (unsigned int i = 0; i < count; i++){
+            life[i] -= dt;
+            px[i] += vx[i] * dt;
+            py[i] += vy[i] * dt;
+            pz[i] += vz[i] * dt;
+            a[i] -= dt * fade;
+        }
+    }
+
+    /** Replace each dead particle by the last live one **/
+    void compact(){
+        unsigned int i = 0;
+        while (i < count){
+            if (life[i] > 0.0f) {
+                i++;
+                continue;
+            }
+            count--;
+            move(count, i);
+        }
+    }
+
+private:
+    void move(unsigned int from, unsigned int to){
+        px[to] = px[from]; py[to] = py[from]; pz[to] = pz[from];
+        vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+        r[to] = r[from]; g[to] = g[from]; b[to] = b[from]; a[to] = a[from];
+        life[to] = life[from];
+    }
+
+    std::vector<std::vector<float>*> components(){
+        return {&px, &py, &pz, &vx, &vy, &vz, &r, &g, &b, &a, &life};
+    }
+
+    unsigned int count = 0;
+    unsigned int limit = 0;
+    unsigned int overwrite = 0;
+};
+#endif
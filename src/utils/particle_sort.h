@@ -0,0 +1,155 @@
+/**
+* @brief This header file defines the back-to-front ordering of the particles of a ParticlePool, by a radix sort of
+* their quantized view depth or by depth buckets for the very large pools
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef PARTICLE_SORT_H
+#define PARTICLE_SORT_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "./particle_pool.h"
+
+/** Order in which the live particles are drawn **/
+enum ParticleSort {
+    PARTICLES_UNSORTED,     // pool order, enough for additive blending
+    PARTICLES_SORTED,       // back to front by a radix sort of a 16 bits depth
+    PARTICLES_BUCKETED      // back to front by 2048 depth buckets, the order inside a bucket is arbitrary
+};
+
+// above this number of live particles the sorted mode uses the buckets, one pass over the keys instead of two
+const unsigned int PARTICLE_BUCKET_THRESHOLD = 262144;
+// the previous order is kept while the camera moves less than this (world units, cosine of the rotation)
+const float PARTICLE_SORT_MOVE = 0.05f;
+const float PARTICLE_SORT_TURN = 0.9995f;
+// frames after which the order is computed again even with a still camera, the particles move by themselves
+const int PARTICLE_SORT_REUSE = 4;
+
+/**
+ * @brief Computes the back to front order of the live particles of a pool. The depth along the view direction is
+ * quantized between the farthest and the nearest particle, then sorted by a least significant digit radix sort
+ * (two passes of 8 bits) or scattered in buckets by one counting pass
+**/
+class ParticleSorter{
+public:
+    ParticleSort mode = PARTICLES_UNSORTED;
+
+    /** Indices of the live particles of 'pool' in drawing order, seen from 'eye' looking along 'front' **/
+    const std::vector<uint32_t>& sort(const ParticlePool& pool, glm::vec3 eye, glm::vec3 front){
+        unsigned int count = pool.size();
+        if (mode == PARTICLES_UNSORTED){
+            invalidate();
+            order.resize(count);
+            for (unsigned int i = 0; i < count; i++) order[i] = i;
+            return order;
+        }
+        if (reusable(eye, front)){
+            repair(count);
+            return order;
+        }
+        last_eye = eye;
+        last_front = front;
+        reused = 0;
+        sorted_count = count;
+
+        depth(pool, eye, front);
+        if (mode == PARTICLES_BUCKETED || count > PARTICLE_BUCKET_THRESHOLD) bucket_sort(count);
+        else radix_sort(count);
+        return order;
+    }
+
+    /** Forget the previous order, the next sort starts from scratch **/
+    void invalidate(){
+        reused = PARTICLE_SORT_REUSE;
+    }
+
+private:
+    /** True if the order of the previous frame is still good enough for a camera at 'eye' looking along 'front' **/
+    bool reusable(glm::vec3 eye, glm::vec3 front){
+        if (reused >= PARTICLE_SORT_REUSE) return false;
+        if (glm::length(eye - last_eye) > PARTICLE_SORT_MOVE || glm::dot(front, last_front) < PARTICLE_SORT_TURN) return false;
+        reused++;
+        return true;
+    }
+
+    /**
+     * Fit the previous order to the pool of this frame : the slots removed by the compaction are dropped and the
+     * particles spawned since are drawn last, they're next to their emitter which is usually in front of its trail
+    **/
+    void repair(unsigned int count){
+        size_t kept = 0;
+        for (size_t i = 0; i < order.size(); i++)
+            if (order[i] < count) order[kept++] = order[i];
+        order.resize(kept);
+        for (unsigned int i = sorted_count; i < count; i++) order.push_back(i);
+        sorted_count = count;
+    }
+
+    /** View depth of each live particle, quantized to 16 bits, 0 for the farthest one **/
+    void depth(const ParticlePool& pool, glm::vec3 eye, glm::vec3 front){
+        unsigned int count = pool.size();
+        distances.resize(count);
+        keys.resize(count);
+        float base = glm::dot(eye, front);
+        float nearest = 0.0f, farthest = 0.0f;
+        for (unsigned int i = 0; i < count; i++){
+            float d = pool.px[i] * front.x + pool.py[i] * front.y + pool.pz[i] * front.z - base;
+            distances[i] = d;
+            nearest = i == 0 ? d : std::min(nearest, d);
+            farthest = i == 0 ? d : std::max(farthest, d);
+        }
+        float scale = farthest > nearest ? 65535.0f / (farthest - nearest) : 0.0f;
+        for (unsigned int i = 0; i < count; i++) keys[i] = (uint16_t)((farthest - distances[i]) * scale);
+    }
+
+    /** Two counting passes over the low then the high byte of the keys, stable so the result is fully sorted **/
+    void radix_sort(unsigned int count){
+        order.resize(count);
+        scratch.resize(count);
+        for (unsigned int i = 0; i < count; i++) scratch[i] = i;
+        for (int shift = 0; shift < 16; shift += 8){
+            uint32_t offsets[256] = {0};
+            for (unsigned int i = 0; i < count; i++) offsets[(keys[scratch[i]] >> shift) & 0xff]++;
+            uint32_t total = 0;
+            for (int digit = 0; digit < 256; digit++){
+                uint32_t size = offsets[digit];
+                offsets[digit] = total;
+                total += size;
+            }
+            for (unsigned int i = 0; i < count; i++){
+                uint32_t index = scratch[i];
+                order[offsets[(keys[index] >> shift) & 0xff]++] = index;
+            }
+            // the output of the first pass is the input of the second one
+            if (shift == 0) std::swap(order, scratch);
+        }
+    }
+
+    /** One counting pass on the 11 high bits of the keys, the order inside a bucket is the pool order **/
+    void bucket_sort(unsigned int count){
+        order.resize(count);
+        offsets.assign(2048, 0);
+        for (unsigned int i = 0; i < count; i++) offsets[keys[i] >> 5]++;
+        uint32_t total = 0;
+        for (uint32_t& offset : offsets){
+            uint32_t size = offset;
+            offset = total;
+            total += size;
+        }
+        for (unsigned int i = 0; i < count; i++) order[offsets[keys[i] >> 5]++] = i;
+    }
+
+    std::vector<uint32_t> order, scratch, offsets;
+    std::vector<float> distances;
+    std::vector<uint16_t> keys;
+    glm::vec3 last_eye = glm::vec3(0.0f), last_front = glm::vec3(0.0f);
+    int reused = PARTICLE_SORT_REUSE;
+    unsigned int sorted_count = 0;
+};
+#endif
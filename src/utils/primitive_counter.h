@@ -0,0 +1,67 @@
+/**
+* @brief This header file defines the PrimitiveCounter class, the number of primitives generated by a draw read back
+* from a GL_PRIMITIVES_GENERATED query without waiting for the GPU
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef PRIMITIVE_COUNTER_H
+#define PRIMITIVE_COUNTER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// queries in flight, the result of a frame is read a few frames later when the GPU is done with it
+const int PRIMITIVE_QUERIES = 4;
+
+/**
+ * @brief Count the primitives (the triangles out of the tessellator for the terrain) generated between begin() and
+ * end(). The queries are used in turn and a result is only read once it's available, so the count lags a few frames
+**/
+class PrimitiveCounter{
+public:
+    // primitives of the latest frame whose result arrived
+    GLuint primitives = 0;
+
+    PrimitiveCounter(){
+        glGenQueries(PRIMITIVE_QUERIES, queries);
+    }
+
+    PrimitiveCounter(const PrimitiveCounter&) = delete;
+    PrimitiveCounter& operator=(const PrimitiveCounter&) = delete;
+
+    ~PrimitiveCounter(){
+        // the queries are already gone if the context was destroyed first
+        if (glfwGetCurrentContext() == nullptr) return;
+        glDeleteQueries(PRIMITIVE_QUERIES, queries);
+    }
+
+    void begin(){
+        // the oldest query is reused, read it first if it has arrived
+        read(current);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, queries[current]);
+    }
+
+    void end(){
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        pending[current] = true;
+        current = (current + 1) % PRIMITIVE_QUERIES;
+    }
+
+private:
+    void read(int index){
+        if (!pending[index]) return;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        // a result still on its way is dropped rather than waited for
+        if (available) glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT, &primitives);
+        pending[index] = false;
+    }
+
+    GLuint queries[PRIMITIVE_QUERIES];
+    bool pending[PRIMITIVE_QUERIES] = {false, false, false, false};
+    int current = 0;
+};
+#endif
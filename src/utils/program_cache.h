@@ -0,0 +1,157 @@
+/**
+* @brief This header file defines the ProgramCache class keeping the linked shader programs on disk
+* (glGetProgramBinary/glProgramBinary) so that the next launches skip the compilation of the shaders
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include "./mapped_file.h"
+
+#ifndef PATH_TO_SHADER_CACHE
+#define PATH_TO_SHADER_CACHE PATH_TO_SHADER "/cache"
+#endif
+
+// Bump the version each time the layout of the header changes, older files are then ignored
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const char PROGRAM_CACHE_MAGIC[4] = {'V', 'R', 'P', 'B'};
+
+/**
+ * @brief Header of a ´.bin´ program file, followed by 'size' bytes of the binary given by the driver
+**/
+struct ProgramHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;               // FNV-1a of the sources and of the driver strings
+    uint32_t format;            // binary format of the driver
+    uint32_t size;
+};
+
+/**
+ * @brief Cache of the linked programs, one file per set of sources. A binary only works with the driver that made it,
+ * the vendor, renderer and version strings are part of the key and a binary rejected anyway is compiled again
+**/
+class ProgramCache{
+public:
+    /** Created by the first shader, on the OpenGL thread **/
+    static ProgramCache& get(){
+        static ProgramCache cache;
+        return cache;
+    }
+
+    /** Key of the program made of the sources of 'stages' (type of the stage and its code) **/
+    uint64_t key(const std::vector<std::pair<GLenum, std::string>>& stages) const {
+        uint64_t hash = driver_hash;
+        for (const auto& stage : stages){
+            hash = hash_bytes(&stage.first, sizeof(GLenum), hash);
+            hash = hash_bytes(stage.second.data(), stage.second.size(), hash);
+        }
+        return hash;
+    }
+
+    /** Create a program from the binary cached for 'key', returns 0 if there is none or if the driver rejects it **/
+    GLuint load(uint64_t key){
+        if (!enabled) return 0;
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file(path(key).c_str());
+        if (!file.is_open() || file.size() < sizeof(ProgramHeader)) return 0;
+        ProgramHeader header;
+        std::memcpy(&header, file.data(), sizeof(ProgramHeader));
+        if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) != 0 || header.version != PROGRAM_CACHE_VERSION ||
+            header.key != key || file.size() != sizeof(ProgramHeader) + header.size) return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, file.data() + sizeof(ProgramHeader), header.size);
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success){
+            std::cout << "The driver rejected the cached program " << path(key) << ", it's compiled again" << std::endl;
+            glDeleteProgram(program);
+            file.close();
+            std::remove(path(key).c_str());
+            return 0;
+        }
+        loaded++;
+        load_ms += elapsed_ms(start);
+        return program;
+    }
+
+    /** Ask the driver to keep the binary of a program, to call before linking it **/
+    void prepare(GLuint program) const {
+        if (enabled) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    /** Write the binary of a linked program, 'compile_ms' is the time spent compiling and linking it **/
+    void store(uint64_t key, GLuint program, double compile_ms){
+        compiled++;
+        this->compile_ms += compile_ms;
+        if (!enabled) return;
+        GLint success, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0) return;
+
+        std::vector<char> file(sizeof(ProgramHeader) + length);
+        ProgramHeader header;
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        GLenum format;
+        glGetProgramBinary(program, length, &length, &format, file.data() + sizeof(ProgramHeader));
+        header.format = format;
+        header.size = (uint32_t)length;
+        std::memcpy(file.data(), &header, sizeof(ProgramHeader));
+        file.resize(sizeof(ProgramHeader) + length);
+        if (!make_directory(PATH_TO_SHADER_CACHE) || !write_file_atomic(path(key), file.data(), file.size()))
+            std::cout << "Failed to write the cached program " << path(key) << std::endl;
+    }
+
+    /** Print how many programs came from the cache and how many were compiled, and the time spent on each **/
+    void report() const {
+        std::cout << "Programs : " << loaded << " loaded from the cache in " << load_ms << " ms, " << compiled
+                  << " compiled in " << compile_ms << " ms" << std::endl;
+    }
+
+    static double elapsed_ms(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    ProgramCache(){
+        // program binaries are core since OpenGL 4.1, the driver may still support no format at all
+        GLint formats = 0;
+        if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        enabled = formats > 0;
+        std::string driver;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}){
+            const GLubyte* value = glGetString(name);
+            if (value) driver += std::string((const char*)value) + "\n";
+        }
+        driver_hash = hash_bytes(driver.data(), driver.size());
+    }
+
+    static std::string path(uint64_t key){
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+        return PATH_TO_SHADER_CACHE + std::string(name);
+    }
+
+    bool enabled = false;
+    uint64_t driver_hash = 0;
+    int loaded = 0, compiled = 0;
+    double load_ms = 0.0, compile_ms = 0.0;
+};
+#endif
@@ -0,0 +1,28 @@
+/**
+* @brief This header file selects the vector instruction set of the SIMD kernels (frustum culling, particles,
+* terrain collisions and normals) from the compiler flags, every kernel has a scalar fallback
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef SIMD_H
+#define SIMD_H
+
+// SIMD_SSE is set on every x86-64 target and SIMD_AVX as well when AVX is enabled by the compiler flags (-mavx or
+// -march=native), the kernels take the widest one they support. SIMD_NONE forces the scalar fallbacks
+#if defined(SIMD_NONE)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON
+#endif
+
+#endif
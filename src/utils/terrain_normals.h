@@ -0,0 +1,200 @@
+/**
+* @brief This header file defines the normal map of the terrain, baked from the heightmap with a Sobel filter and
+* cached in a ´.normals´ file next to the heightmap
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TERRAIN_NORMALS_H
+#define TERRAIN_NORMALS_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "./mapped_file.h"
+#include "./simd.h"
+
+// Bump the version each time the layout of the header or the encoding of the texels changes, older files are then rebuilt
+const uint32_t TERRAIN_NORMALS_VERSION = 1;
+const char TERRAIN_NORMALS_MAGIC[4] = {'T', 'N', 'R', 'M'};
+
+/**
+ * @brief Header of a ´.normals´ file, followed by width * height RGBA8 texels. The file is valid for one heightmap
+ * and one vertical scale
+**/
+struct NormalMapHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;       // FNV-1a of the heightmap file
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint32_t width;
+    uint32_t height;
+    float scale;                // world height of one step of the samples
+    uint32_t reserved;
+};
+
+/**
+ * @brief One texel per sample of the heightmap : the unit normal * 0.5 + 0.5 in RGB and the slope (1 - normal.y,
+ * 0 for a flat ground) in A. The samples are one world unit apart, like the texels of the island
+**/
+struct NormalMap {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> texels;
+};
+
+/** Texel of the normal (-dx, 1, -dz) normalized, 'dx' and 'dz' being the slopes of the height along x and z **/
+inline uint32_t pack_normal(float dx, float dz){
+    float inverse = 1.0f / std::sqrt(1.0f + dx * dx + dz * dz);
+    uint32_t r = (uint32_t)(-dx * inverse * 127.5f + 128.0f);
+    uint32_t g = (uint32_t)(inverse * 127.5f + 128.0f);
+    uint32_t b = (uint32_t)(-dz * inverse * 127.5f + 128.0f);
+    uint32_t a = (uint32_t)((1.0f - inverse) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+#if defined(SIMD_SSE)
+/** Four samples widened to 32 bits, their sign is kept **/
+inline __m128i load_samples4(const short int* samples){
+    __m128i packed = _mm_loadl_epi64((const __m128i*)samples);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+}
+#endif
+
+/**
+ * @brief Sobel filter of the rows [first, last) of the heightmap into 'texels' (the whole map, only these rows are
+ * written). The samples past the borders repeat the border ones, like a texture clamped to its edges. Rows of
+ * different calls don't overlap, the bands of a map can be filtered by several threads at once
+**/
+inline void sobel_normals(const short int* heights, int width, int height, float scale, int first, int last, uint32_t* texels){
+    // the Sobel weights sum to 8 on each side of the sample, two samples apart
+    float step = scale / 8.0f;
+    for (int j = first; j < last; j++){
+        const short int* up = heights + (size_t)std::max(j - 1, 0) * width;
+        const short int* middle = heights + (size_t)j * width;
+        const short int* down = heights + (size_t)std::min(j + 1, height - 1) * width;
+        uint32_t* row = texels + (size_t)j * width;
+
+        auto texel = [&](int i){
+            int left = std::max(i - 1, 0), right = std::min(i + 1, width - 1);
+            int gx = (up[right] + 2 * middle[right] + down[right]) - (up[left] + 2 * middle[left] + down[left]);
+            int gz = (down[left] + 2 * down[i] + down[right]) - (up[left] + 2 * up[i] + up[right]);
+            row[i] = pack_normal(gx * step, gz * step);
+        };
+
+        texel(0);
+        int i = 1;
+#if defined(SIMD_SSE)
+        // four samples at once, the columns i - 1 and i + 1 are read with unaligned loads
+        __m128 steps = _mm_set1_ps(step), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(127.5f), center = _mm_set1_ps(128.0f);
+        for (; i + 4 < width; i += 4){
+            __m128i ul = load_samples4(up + i - 1), um = load_samples4(up + i), ur = load_samples4(up + i + 1);
+            __m128i ml = load_samples4(middle + i - 1), mr = load_samples4(middle + i + 1);
+            __m128i dl = load_samples4(down + i - 1), dm = load_samples4(down + i), dr = load_samples4(down + i + 1);
+            __m128i gx = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(ur, dr), _mm_slli_epi32(mr, 1)), _mm_add_epi32(_mm_add_epi32(ul, dl), _mm_slli_epi32(ml, 1)));
+            __m128i gz = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(dl, dr), _mm_slli_epi32(dm, 1)), _mm_add_epi32(_mm_add_epi32(ul, ur), _mm_slli_epi32(um, 1)));
+            __m128 dx = _mm_mul_ps(_mm_cvtepi32_ps(gx), steps), dz = _mm_mul_ps(_mm_cvtepi32_ps(gz), steps);
+            // an exact square root keeps the texels equal to the ones of pack_normal()
+            __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(one, _mm_mul_ps(dx, dx)), _mm_mul_ps(dz, dz))));
+            __m128i r = _mm_cvttps_epi32(_mm_sub_ps(center, _mm_mul_ps(_mm_mul_ps(dx, inverse), half)));
+            __m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(inverse, half), center));
+            __m128i b = _mm_cvttps_epi32(_mm_sub_ps(center, _mm_mul_ps(_mm_mul_ps(dz, inverse), half)));
+            __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, inverse), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+            __m128i packed = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+            _mm_storeu_si128((__m128i*)(row + i), packed);
+        }
+#elif defined(SIMD_NEON)
+        float32x4_t one = vdupq_n_f32(1.0f), center = vdupq_n_f32(128.0f);
+        for (; i + 4 < width; i += 4){
+            int32x4_t ul = vmovl_s16(vld1_s16(up + i - 1)), um = vmovl_s16(vld1_s16(up + i)), ur = vmovl_s16(vld1_s16(up + i + 1));
+            int32x4_t ml = vmovl_s16(vld1_s16(middle + i - 1)), mr = vmovl_s16(vld1_s16(middle + i + 1));
+            int32x4_t dl = vmovl_s16(vld1_s16(down + i - 1)), dm = vmovl_s16(vld1_s16(down + i)), dr = vmovl_s16(vld1_s16(down + i + 1));
+            int32x4_t gx = vsubq_s32(vaddq_s32(vaddq_s32(ur, dr), vshlq_n_s32(mr, 1)), vaddq_s32(vaddq_s32(ul, dl), vshlq_n_s32(ml, 1)));
+            int32x4_t gz = vsubq_s32(vaddq_s32(vaddq_s32(dl, dr), vshlq_n_s32(dm, 1)), vaddq_s32(vaddq_s32(ul, ur), vshlq_n_s32(um, 1)));
+            float32x4_t dx = vmulq_n_f32(vcvtq_f32_s32(gx), step), dz = vmulq_n_f32(vcvtq_f32_s32(gz), step);
+            float32x4_t squared = vmlaq_f32(vmlaq_f32(one, dx, dx), dz, dz);
+            // reciprocal square root estimate refined twice, well below the precision of the texels
+            float32x4_t inverse = vrsqrteq_f32(squared);
+            inverse = vmulq_f32(inverse, vrsqrtsq_f32(vmulq_f32(squared, inverse), inverse));
+            inverse = vmulq_f32(inverse, vrsqrtsq_f32(vmulq_f32(squared, inverse), inverse));
+            uint32x4_t r = vcvtq_u32_f32(vmlsq_n_f32(center, vmulq_f32(dx, inverse), 127.5f));
+            uint32x4_t g = vcvtq_u32_f32(vmlaq_n_f32(center, inverse, 127.5f));
+            uint32x4_t b = vcvtq_u32_f32(vmlsq_n_f32(center, vmulq_f32(dz, inverse), 127.5f));
+            uint32x4_t a = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), vsubq_f32(one, inverse), 255.0f));
+            uint32x4_t packed = vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), vorrq_u32(vshlq_n_u32(b, 16), vshlq_n_u32(a, 24)));
+            vst1q_u32(row + i, packed);
+        }
+#endif
+        for (; i < width; i++) texel(i);
+    }
+}
+
+/** Path of the normal map cached for a heightmap **/
+inline std::string normal_map_path(const char* path){
+    return replace_extension(path, ".normals");
+}
+
+/** Read the ´.normals´ file of the heightmap 'source_path', returns false if it's missing or stale **/
+inline bool load_normal_map(const char* source_path, float scale, NormalMap& map){
+    int64_t mtime;
+    uint64_t size;
+    if (!file_info(source_path, mtime, size)) return false;
+
+    MappedFile file;
+    if (!file.open(normal_map_path(source_path).c_str()) || file.size() < sizeof(NormalMapHeader)) return false;
+    NormalMapHeader header;
+    std::memcpy(&header, file.data(), sizeof(NormalMapHeader));
+    size_t texels = (size_t)header.width * header.height;
+    bool valid = std::memcmp(header.magic, TERRAIN_NORMALS_MAGIC, 4) == 0 && header.version == TERRAIN_NORMALS_VERSION
+              && header.scale == scale && header.source_size == size && file.size() == sizeof(NormalMapHeader) + texels * sizeof(uint32_t);
+    // a different modification time alone doesn't invalidate the cache if the content is the same
+    if (valid && header.source_mtime != mtime){
+        MappedFile source(source_path);
+        valid = source.is_open() && hash_bytes(source.data(), source.size()) == header.source_hash;
+        // the new time is recorded so that the next runs skip the hash, like the mesh cache
+        if (valid){
+            header.source_mtime = mtime;
+            overwrite_file_start(normal_map_path(source_path), &header, sizeof(NormalMapHeader));
+        }
+    }
+    if (!valid) return false;
+
+    map.width = (int)header.width;
+    map.height = (int)header.height;
+    map.texels.resize(texels);
+    std::memcpy(map.texels.data(), file.data() + sizeof(NormalMapHeader), texels * sizeof(uint32_t));
+    return true;
+}
+
+/** Write the ´.normals´ file of 'map' next to the heightmap 'source_path', returns false if it can't be written **/
+inline bool write_normal_map(const char* source_path, float scale, const NormalMap& map){
+    int64_t mtime;
+    uint64_t size;
+    if (!file_info(source_path, mtime, size)) return false;
+    MappedFile source(source_path);
+    if (!source.is_open()) return false;
+
+    NormalMapHeader header;
+    std::memset(&header, 0, sizeof(NormalMapHeader));
+    std::memcpy(header.magic, TERRAIN_NORMALS_MAGIC, 4);
+    header.version = TERRAIN_NORMALS_VERSION;
+    header.source_hash = hash_bytes(source.data(), source.size());
+    header.source_mtime = mtime;
+    header.source_size = size;
+    header.width = (uint32_t)map.width;
+    header.height = (uint32_t)map.height;
+    header.scale = scale;
+
+    size_t texel_bytes = map.texels.size() * sizeof(uint32_t);
+    std::vector<char> file(sizeof(NormalMapHeader) + texel_bytes);
+    std::memcpy(file.data(), &header, sizeof(NormalMapHeader));
+    if (texel_bytes) std::memcpy(file.data() + sizeof(NormalMapHeader), map.texels.data(), texel_bytes);
+    return write_file_atomic(normal_map_path(source_path), file.data(), file.size());
+}
+#endif
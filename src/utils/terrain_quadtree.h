@@ -0,0 +1,252 @@
+/**
+* @brief This header file defines the TerrainQuadtree class, the level of detail selection and the culling of the
+* patches of the tessellated terrain, and the roughness of the heightmap that scales their tessellation
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TERRAIN_QUADTREE_H
+#define TERRAIN_QUADTREE_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "./frustum.h"
+
+// levels of the tree, the leaves are a grid of 2^(TERRAIN_LEVELS-1) x 2^(TERRAIN_LEVELS-1) patches
+const int TERRAIN_LEVELS = 6;
+// a node is split while the camera is closer to its box than TERRAIN_LOD_RANGE times its size
+const float TERRAIN_LOD_RANGE = 2.0f;
+// cells of the finest level of the roughness map on each side, and the world error at which a cell is fully rough
+const int TERRAIN_ROUGHNESS_CELLS = 128;
+const float TERRAIN_ROUGHNESS_ERROR = 4.0f;
+
+/** Per-instance attributes of a patch streamed to height.vs **/
+struct TerrainPatch {
+    // corner and size of the patch in texture coordinates
+    glm::vec3 node;
+    // lowest and highest world height of the displaced patch
+    glm::vec2 heights;
+    // tessellation of the edges (-x, -z, +x, +z) relative to the interior, 0.5 along a coarser neighbour
+    glm::vec4 edges;
+};
+
+/**
+ * @brief Quadtree over the heightmap in the manner of CDLOD : every node knows the world bounds of its displaced
+ * patch, computed once from the heights. Each frame the tree is walked from the root, the nodes outside the view
+ * are dropped with their whole subtree and the others are split while they're close to the camera, so the size of
+ * the patches grows with the distance and nothing behind the camera is tessellated
+**/
+class TerrainQuadtree{
+public:
+    /**
+     * Bounds of every node of a 'width' x 'height' heightmap covering x in [-width/2, width/2] and z in
+     * [-height/2, height/2], the world height of a sample h is 'base' + 'scale' * h / 255
+    **/
+    void build(const short int* samples, int width, int height, float base, float scale){
+        this->width = (float)width;
+        this->height = (float)height;
+        int leaves = 1 << (TERRAIN_LEVELS - 1);
+        for (int level = 0; level < TERRAIN_LEVELS; level++) bounds[level].assign((size_t)1 << (2 * level), glm::vec2(base, base + scale));
+        if (width <= 0 || height <= 0) return;
+
+        // the texture is sampled with a bilinear filter, the texels next to a leaf take part in its surface
+        std::vector<glm::vec2>& leaf_bounds = bounds[TERRAIN_LEVELS - 1];
+        for (int z = 0; z < leaves; z++){
+            int row_begin = std::max(0, z * height / leaves - 1), row_end = std::min(height, (z + 1) * height / leaves + 1);
+            for (int x = 0; x < leaves; x++){
+                int column_begin = std::max(0, x * width / leaves - 1), column_end = std::min(width, (x + 1) * width / leaves + 1);
+                short int lowest = 255, highest = 0;
+                for (int row = row_begin; row < row_end; row++){
+                    const short int* line = samples + (size_t)row * width;
+                    for (int column = column_begin; column < column_end; column++){
+                        lowest = std::min(lowest, line[column]);
+                        highest = std::max(highest, line[column]);
+                    }
+                }
+                leaf_bounds[z * leaves + x] = glm::vec2(base + scale * lowest / 255.0f, base + scale * highest / 255.0f);
+            }
+        }
+        bake_roughness(samples, width, height, scale);
+
+        // a parent is bounded by its four children
+        for (int level = TERRAIN_LEVELS - 2; level >= 0; level--){
+            int side = 1 << level;
+            for (int z = 0; z < side; z++){
+                for (int x = 0; x < side; x++){
+                    glm::vec2 b = node_bounds(level + 1, 2 * x, 2 * z);
+                    for (int child = 1; child < 4; child++){
+                        glm::vec2 c = node_bounds(level + 1, 2 * x + (child & 1), 2 * z + (child >> 1));
+                        b = glm::vec2(std::min(b.x, c.x), std::max(b.y, c.y));
+                    }
+                    bounds[level][z * side + x] = b;
+                }
+            }
+        }
+    }
+
+    /**
+     * Patches of the frame seen through 'frustum' from 'eye', the nodes selected and dropped are counted by 'stats'.
+     * The edges along a coarser neighbour are tessellated less so that their vertices meet the ones of the neighbour,
+     * which is never more than one level coarser : the nodes next to a finer patch are split until it's true
+    **/
+    void select(const Frustum& frustum, glm::vec3 eye, std::vector<TerrainPatch>& patches, CullingStats& stats){
+        patches.clear();
+        int leaves = 1 << (TERRAIN_LEVELS - 1);
+        for (int level = 0; level < TERRAIN_LEVELS; level++) forced[level].assign((size_t)1 << (2 * level), 0);
+        CullingStats pass;
+        do {
+            pass.reset();
+            selected.clear();
+            lods.assign((size_t)leaves * leaves, -1);
+            visit(0, 0, 0, frustum, eye, pass);
+        } while (!balance());
+        stats.drawn += pass.drawn;
+        stats.culled += pass.culled;
+
+        for (const Selected& node : selected){
+            int side = 1 << node.level;
+            float size = 1.0f / side;
+            TerrainPatch patch;
+            patch.node = glm::vec3(node.x * size, node.z * size, size);
+            patch.heights = node_bounds(node.level, node.x, node.z);
+            int span = leaves / side, x0 = node.x * span, z0 = node.z * span;
+            patch.edges = glm::vec4(edge(node.level, x0 - 1, z0), edge(node.level, x0, z0 - 1),
+                                    edge(node.level, x0 + span, z0), edge(node.level, x0, z0 + span));
+            patches.push_back(patch);
+        }
+    }
+
+    /**
+     * Roughness pyramid of the heightmap, level 0 is TERRAIN_ROUGHNESS_CELLS on each side and every next level
+     * keeps the roughest of 4 cells, down to a single cell
+    **/
+    const std::vector<std::vector<unsigned char>>& roughness() const {
+        return roughness_levels;
+    }
+
+    /** World bounds (lowest, highest) of the node (x, z) of 'level' **/
+    glm::vec2 node_bounds(int level, int x, int z) const {
+        return bounds[level][((size_t)z << level) + x];
+    }
+
+private:
+    /**
+     * The roughness of a cell is the largest distance between the heights and the bilinear surface of its four
+     * corners, what a single quad over the cell would miss, 255 from TERRAIN_ROUGHNESS_ERROR
+    **/
+    void bake_roughness(const short int* samples, int width, int height, float scale){
+        int cells = TERRAIN_ROUGHNESS_CELLS;
+        roughness_levels.assign(1, std::vector<unsigned char>((size_t)cells * cells));
+        for (int z = 0; z < cells; z++){
+            int row_begin = z * height / cells, row_end = std::min(height - 1, (z + 1) * height / cells);
+            for (int x = 0; x < cells; x++){
+                int column_begin = x * width / cells, column_end = std::min(width - 1, (x + 1) * width / cells);
+                const short int* first = samples + (size_t)row_begin * width;
+                const short int* last = samples + (size_t)row_end * width;
+                float h00 = first[column_begin], h01 = first[column_end], h10 = last[column_begin], h11 = last[column_end];
+                float error = 0.0f;
+                for (int row = row_begin; row <= row_end; row++){
+                    float v = row_end > row_begin ? (float)(row - row_begin) / (row_end - row_begin) : 0.0f;
+                    const short int* line = samples + (size_t)row * width;
+                    for (int column = column_begin; column <= column_end; column++){
+                        float u = column_end > column_begin ? (float)(column - column_begin) / (column_end - column_begin) : 0.0f;
+                        float surface = glm::mix(glm::mix(h00, h01, u), glm::mix(h10, h11, u), v);
+                        error = std::max(error, std::abs(line[column] - surface));
+                    }
+                }
+                float roughness = std::min(1.0f, error * scale / 255.0f / TERRAIN_ROUGHNESS_ERROR);
+                roughness_levels[0][(size_t)z * cells + x] = (unsigned char)(roughness * 255.0f + 0.5f);
+            }
+        }
+        for (int side = cells / 2; side >= 1; side /= 2){
+            const std::vector<unsigned char>& finer = roughness_levels.back();
+            std::vector<unsigned char> level((size_t)side * side);
+            for (int z = 0; z < side; z++){
+                for (int x = 0; x < side; x++){
+                    const unsigned char* top = &finer[(size_t)(2 * z) * 2 * side + 2 * x];
+                    const unsigned char* bottom = top + 2 * side;
+                    level[(size_t)z * side + x] = std::max(std::max(top[0], top[1]), std::max(bottom[0], bottom[1]));
+                }
+            }
+            roughness_levels.push_back(level);
+        }
+    }
+
+    struct Selected {
+        int level, x, z;
+    };
+
+    void visit(int level, int x, int z, const Frustum& frustum, glm::vec3 eye, CullingStats& stats){
+        int side = 1 << level;
+        glm::vec2 b = node_bounds(level, x, z);
+        glm::vec3 bounds_min(width * ((float)x / side - 0.5f), b.x, height * ((float)z / side - 0.5f));
+        glm::vec3 bounds_max(width * ((float)(x + 1) / side - 0.5f), b.y, height * ((float)(z + 1) / side - 0.5f));
+        if (!frustum.intersects(bounds_min, bounds_max)) {
+            // the whole subtree is dropped
+            stats.culled++;
+            return;
+        }
+        float distance = glm::length(glm::max(glm::max(bounds_min - eye, eye - bounds_max), glm::vec3(0.0f)));
+        float size = std::max(bounds_max.x - bounds_min.x, bounds_max.z - bounds_min.z);
+        bool split = distance < TERRAIN_LOD_RANGE * size || forced[level][(size_t)z * side + x];
+        if (level < TERRAIN_LEVELS - 1 && split) {
+            for (int child = 0; child < 4; child++) visit(level + 1, 2 * x + (child & 1), 2 * z + (child >> 1), frustum, eye, stats);
+            return;
+        }
+        stats.drawn++;
+        selected.push_back({level, x, z});
+        int leaves = 1 << (TERRAIN_LEVELS - 1), span = leaves / side;
+        for (int row = z * span; row < (z + 1) * span; row++)
+            for (int column = x * span; column < (x + 1) * span; column++) lods[(size_t)row * leaves + column] = (int8_t)level;
+    }
+
+    /**
+     * Mark the nodes more than one level coarser than a selected neighbour to be split by the next walk, returns true
+     * if there was none. Each walk only splits coarser nodes, so it ends within a few walks
+    **/
+    bool balance(){
+        int leaves = 1 << (TERRAIN_LEVELS - 1);
+        bool balanced = true;
+        for (const Selected& node : selected){
+            if (node.level < 2) continue;
+            int span = leaves >> node.level, x0 = node.x * span, z0 = node.z * span;
+            for (int i = 0; i < span; i++){
+                // the leaves across the edges (-x, -z, +x, +z)
+                int across[4][2] = {{x0 - 1, z0 + i}, {x0 + i, z0 - 1}, {x0 + span, z0 + i}, {x0 + i, z0 + span}};
+                for (const auto& leaf : across){
+                    if (leaf[0] < 0 || leaf[1] < 0 || leaf[0] >= leaves || leaf[1] >= leaves) continue;
+                    int neighbour = lods[(size_t)leaf[1] * leaves + leaf[0]];
+                    if (neighbour < 0 || neighbour >= node.level - 1) continue;
+                    int shift = TERRAIN_LEVELS - 1 - neighbour;
+                    forced[neighbour][((size_t)(leaf[1] >> shift) << neighbour) + (leaf[0] >> shift)] = 1;
+                    balanced = false;
+                }
+            }
+        }
+        return balanced;
+    }
+
+    /** Tessellation of an edge of a node of 'level' whose neighbour covers the leaf (x, z) **/
+    float edge(int level, int x, int z) const {
+        int leaves = 1 << (TERRAIN_LEVELS - 1);
+        if (x < 0 || z < 0 || x >= leaves || z >= leaves) return 1.0f;
+        int neighbour = lods[(size_t)z * leaves + x];
+        if (neighbour < 0 || neighbour >= level) return 1.0f;
+        return 1.0f / (float)(1 << (level - neighbour));
+    }
+
+    std::vector<glm::vec2> bounds[TERRAIN_LEVELS];
+    std::vector<std::vector<unsigned char>> roughness_levels;
+    // level of the patch covering each leaf this frame, -1 where nothing is drawn
+    std::vector<int8_t> lods;
+    // nodes split whatever their distance to keep their neighbours within one level
+    std::vector<uint8_t> forced[TERRAIN_LEVELS];
+    std::vector<Selected> selected;
+    float width = 0.0f, height = 0.0f;
+};
+#endif
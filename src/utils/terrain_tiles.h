@@ -0,0 +1,98 @@
+/**
+* @brief This header file defines the ´.tiles´ packs of the tiled terrain : a large 16 bits heightmap cut offline into
+* square tiles holding every mip level, read back one tile at a time from the mapped file
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef TERRAIN_TILES_H
+#define TERRAIN_TILES_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "./mapped_file.h"
+
+const char TILE_PACK_MAGIC[4] = {'T', 'T', 'L', '1'};
+// patches on each side of a tile, the tile size is a multiple of it so that every patch covers the same samples
+const int TERRAIN_TILE_PATCHES = 8;
+
+/**
+ * @brief Header of a pack, followed by the offset of each tile (row by row) and by the tiles. A tile of 'tile_size'
+ * holds (tile_size + 1)^2 samples at level 0, its last row and column are the first ones of the next tiles so that
+ * the borders of two tiles meet. The next levels follow the sizes of the mip levels of OpenGL
+**/
+struct TilePackHeader {
+    char magic[4];
+    uint32_t tile_size;
+    uint32_t tiles_x;
+    uint32_t tiles_z;
+    uint32_t levels;
+    // world distance between two samples, and world height of the sample 65535
+    float spacing;
+    float height;
+    uint32_t reserved;
+};
+
+/** Samples on each side of the level 'level' of a tile **/
+inline uint32_t tile_level_side(uint32_t tile_size, uint32_t level){
+    return std::max(1u, (tile_size + 1) >> level);
+}
+
+/** Number of levels of a tile, down to a single sample **/
+inline uint32_t tile_levels(uint32_t tile_size){
+    uint32_t levels = 1;
+    while (((tile_size + 1) >> levels) > 0) levels++;
+    return levels;
+}
+
+/** Samples of a whole tile, every level **/
+inline size_t tile_samples(uint32_t tile_size, uint32_t levels){
+    size_t samples = 0;
+    for (uint32_t level = 0; level < levels; level++){
+        size_t side = tile_level_side(tile_size, level);
+        samples += side * side;
+    }
+    return samples;
+}
+
+/**
+ * @brief Read access to a mapped pack. Only the pages of the tiles read are loaded by the system, the pack can be
+ * larger than the memory. It's read-only once opened, any thread can read its tiles
+**/
+class TilePack{
+public:
+    TilePackHeader header;
+
+    TilePack(){
+        std::memset(&header, 0, sizeof(header));
+    }
+
+    /** Map the pack 'path', returns false if it isn't a valid pack **/
+    bool open(const std::string& path){
+        if (!file.open(path.c_str()) || file.size() < sizeof(TilePackHeader)) return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, TILE_PACK_MAGIC, 4) != 0 || header.tile_size == 0 || header.levels != tile_levels(header.tile_size)) return false;
+        if (header.tile_size % TERRAIN_TILE_PATCHES != 0) return false;
+        size_t tiles = (size_t)header.tiles_x * header.tiles_z;
+        if (file.size() < sizeof(TilePackHeader) + tiles * sizeof(uint64_t)) return false;
+        offsets = (const uint64_t*)(file.data() + sizeof(TilePackHeader));
+        for (size_t i = 0; i < tiles; i++)
+            if (offsets[i] + tile_samples(header.tile_size, header.levels) * sizeof(uint16_t) > file.size()) return false;
+        return true;
+    }
+
+    /** Samples of the tile (x, z), every level one after the other **/
+    const uint16_t* tile(uint32_t x, uint32_t z) const {
+        return (const uint16_t*)(file.data() + offsets[(size_t)z * header.tiles_x + x]);
+    }
+
+private:
+    MappedFile file;
+    const uint64_t* offsets = nullptr;
+};
+#endif
@@ -0,0 +1,206 @@
+/**
+* @brief This header file defines the UniformTable class holding the locations of the active uniforms of a program,
+* reflected once after the link, and the UniformHandle used to set a uniform without looking up its name
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+inline void upload_uniform(GLint location, int value) { glUniform1i(location, value); }
+inline void upload_uniform(GLint location, float value) { glUniform1f(location, value); }
+inline void upload_uniform(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, glm::value_ptr(value)); }
+inline void upload_uniform(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, glm::value_ptr(value)); }
+inline void upload_uniform(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, glm::value_ptr(value)); }
+inline void upload_uniform(GLint location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+inline void upload_uniform(GLint location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+inline void upload_uniform(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+/** Send a value kept as raw bytes, the type is the one it was set with **/
+template<typename T>
+inline void upload_stored(GLint location, const void* value) {
+    T typed;
+    std::memcpy(&typed, value, sizeof(T));
+    upload_uniform(location, typed);
+}
+
+/**
+ * @brief Active uniforms of a linked program in a flat hash table (open addressing, linear probing) indexed by the
+ * hash of their name. Each uniform keeps the last value sent so that setting the same value again costs no OpenGL call.
+ * The values are only right if they're always set through the table while the program is in use
+**/
+class UniformTable{
+public:
+    /** Reflect the active uniforms of 'program', the arrays are also reachable by their name without [0] and by each element **/
+    explicit UniformTable(GLuint program){
+        GLint count = 0, max_length = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+        std::vector<GLchar> buffer(max_length + 1);
+        for (GLint i = 0; i < count; i++){
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(program, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            // the uniforms of the uniform blocks have no location
+            if (location < 0) continue;
+            add(name, location);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+                std::string base = name.substr(0, name.size() - 3);
+                // the name without [0] is the same uniform as the first element
+                alias(base);
+                for (GLint element = 1; element < size; element++){
+                    std::string element_name = base + "[" + std::to_string(element) + "]";
+                    add(element_name, glGetUniformLocation(program, element_name.c_str()));
+                }
+            }
+        }
+        build();
+    }
+
+    /** Index of the uniform 'name', -1 if the program doesn't use it **/
+    int find(const char* name) const {
+        if (buckets.empty()) return -1;
+        uint32_t hash = hash_name(name);
+        for (uint32_t b = hash & mask; buckets[b] >= 0; b = (b + 1) & mask){
+            const Name& entry = names[buckets[b]];
+            if (entry.hash == hash && entry.name == name) return entry.uniform;
+        }
+        return -1;
+    }
+
+    GLint location(int index) const {
+        return index < 0 ? -1 : uniforms[index].location;
+    }
+
+    /** Send 'value' to the uniform 'index' unless it already holds it **/
+    template<typename T>
+    void set(int index, const T& value){
+        static_assert(sizeof(T) <= sizeof(Uniform::value), "uniform value too large");
+        if (index < 0) return;
+        Uniform& uniform = uniforms[index];
+        if (uniform.known && std::memcmp(uniform.value, &value, sizeof(T)) == 0) return;
+        std::memcpy(uniform.value, &value, sizeof(T));
+        uniform.known = true;
+        uniform.upload = &upload_stored<T>;
+        upload_uniform(uniform.location, value);
+    }
+
+    /** Send the values known by 'other' to the uniforms of the same name, while this program is in use **/
+    void copy_values(const UniformTable& other){
+        for (const Name& entry : other.names){
+            const Uniform& source = other.uniforms[entry.uniform];
+            int index = find(entry.name.c_str());
+            if (!source.known || index < 0 || uniforms[index].known) continue;
+            Uniform& uniform = uniforms[index];
+            std::memcpy(uniform.value, source.value, sizeof(uniform.value));
+            uniform.known = true;
+            uniform.upload = source.upload;
+            uniform.upload(uniform.location, uniform.value);
+        }
+    }
+
+    /** Forget the values sent, to call after some code set uniforms of the program without the table **/
+    void invalidate(){
+        for (Uniform& uniform : uniforms) uniform.known = false;
+    }
+
+    size_t size() const {
+        return uniforms.size();
+    }
+
+private:
+    struct Name {
+        std::string name;
+        uint32_t hash = 0;
+        int uniform = -1;
+    };
+
+    struct Uniform {
+        GLint location = -1;
+        bool known = false;
+        unsigned char value[sizeof(glm::mat4)];
+        // upload function of the type of the value
+        void (*upload)(GLint, const void*) = nullptr;
+    };
+
+    /** FNV-1a hash of a name **/
+    static uint32_t hash_name(const char* name){
+        uint32_t hash = 2166136261u;
+        for (; *name; name++) hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+
+    void add(const std::string& name, GLint location){
+        Uniform uniform;
+        uniform.location = location;
+        uniforms.push_back(uniform);
+        alias(name);
+    }
+
+    /** Make 'name' lead to the last uniform added **/
+    void alias(const std::string& name){
+        Name entry;
+        entry.name = name;
+        entry.hash = hash_name(name.c_str());
+        entry.uniform = (int)uniforms.size() - 1;
+        names.push_back(entry);
+    }
+
+    /** Fill the buckets, at most half full **/
+    void build(){
+        uint32_t capacity = 8;
+        while (capacity < names.size() * 2) capacity *= 2;
+        mask = capacity - 1;
+        buckets.assign(capacity, -1);
+        for (size_t i = 0; i < names.size(); i++){
+            uint32_t b = names[i].hash & mask;
+            while (buckets[b] >= 0) b = (b + 1) & mask;
+            buckets[b] = (int)i;
+        }
+    }
+
+    std::vector<Name> names;
+    std::vector<Uniform> uniforms;
+    // index of a name in 'names' or -1
+    std::vector<int> buckets;
+    uint32_t mask = 0;
+};
+
+/**
+ * @brief Uniform of a program resolved once, setting it never looks up its name. Setting a uniform that the
+ * program doesn't use does nothing
+**/
+template<typename T>
+class UniformHandle{
+public:
+    UniformHandle(){}
+    UniformHandle(UniformTable* table, int index) : table(table), index(index) {}
+
+    void set(const T& value) const {
+        if (table) table->set(index, value);
+    }
+
+    bool valid() const {
+        return table && index >= 0;
+    }
+
+private:
+    UniformTable* table = nullptr;
+    int index = -1;
+};
+#endif
@@ -0,0 +1,81 @@
+/**
+* @brief This header file defines the compact vertex layout and the functions quantizing a Vertex array into it
+*
+* @author Adela Surca & Laurent Colpaert
+*
+* @project OpenGL project
+*
+**/
+#ifndef VERTEX_COMPRESSION_H
+#define VERTEX_COMPRESSION_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "./obj_loader.h"
+
+/**
+ * @brief 16 bytes vertex : snorm16 position relative to the bounds of the mesh, snorm8 normal and unorm16 uv in
+ * [0, 1] (the meshes drawn compact don't repeat their textures). The shaders get the position back with
+ * 'position * u_pos_scale + u_pos_offset', the uv needs nothing
+**/
+struct CompactVertex {
+    int16_t Position[4];    // the 4th component is padding
+    int8_t Normal[4];       // the 4th component is padding
+    uint16_t Texture[2];
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay 16 bytes");
+
+/** Scale and offset that bring the quantized attributes back to their original range **/
+struct VertexDequantization {
+    glm::vec3 pos_scale = glm::vec3(1.0f);
+    glm::vec3 pos_offset = glm::vec3(0.0f);
+};
+
+inline int16_t quantize_snorm16(float v){
+    return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+}
+
+inline int8_t quantize_snorm8(float v){
+    return (int8_t)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 127.0f);
+}
+
+inline uint16_t quantize_unorm16(float v){
+    return (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, v)) * 65535.0f);
+}
+
+/**
+ * @brief Quantize 'count' vertices into the compact layout. The position is expressed relative to the
+ * bounding box [bounds_min, bounds_max] of the mesh, returns the dequantization parameters
+**/
+inline VertexDequantization compress_vertices(const Vertex* vertices, size_t count, glm::vec3 bounds_min, glm::vec3 bounds_max,
+                                              std::vector<CompactVertex>& compact){
+    VertexDequantization dequant;
+    dequant.pos_offset = (bounds_min + bounds_max) * 0.5f;
+    dequant.pos_scale = (bounds_max - bounds_min) * 0.5f;
+
+    // a flat axis has a null scale, every vertex is then encoded at the offset
+    glm::vec3 pos_inv(0.0f);
+    for (int k = 0; k < 3; k++) pos_inv[k] = dequant.pos_scale[k] > 0.0f ? 1.0f / dequant.pos_scale[k] : 0.0f;
+
+    compact.resize(count);
+    for (size_t i = 0; i < count; i++){
+        const Vertex& v = vertices[i];
+        CompactVertex& c = compact[i];
+        glm::vec3 p = (v.Position - dequant.pos_offset) * pos_inv;
+        glm::vec3 n = glm::length(v.Normal) > 0.0f ? glm::normalize(v.Normal) : glm::vec3(0.0f);
+        for (int k = 0; k < 3; k++){
+            c.Position[k] = quantize_snorm16(p[k]);
+            c.Normal[k] = quantize_snorm8(n[k]);
+        }
+        c.Position[3] = 0;
+        c.Normal[3] = 0;
+        // the uv is read as a normalized integer, it's the same as the float one without any uniform
+        c.Texture[0] = quantize_unorm16(v.Texture.x);
+        c.Texture[1] = quantize_unorm16(v.Texture.y);
+    }
+    return dequant;
+}
+#endif
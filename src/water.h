@@ -12,8 +12,10 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
-#include "./simple_shader.h"
+#include <cmath>
+#include "./shader_program.h"
 #include "./object.h"
+#include "./texture_cache.h"
 
 /**
 * @brief Class that handle a 3D plane object to move like waves
@@ -21,12 +23,16 @@
 class Water{
 public:
     Object plane;
-    Shader water_shader = Shader(PATH_TO_SHADER "/water/water.vs", PATH_TO_SHADER "/water/water.fs"); 
+    ShaderProgram water_shader = ShaderProgram(PATH_TO_SHADER "/water/water.vs", PATH_TO_SHADER "/water/water.fs", nullptr,
+        nullptr, nullptr, {{"COMPACT_VERTEX", "1"}});
 
     /** Constructor **/
     Water(int length,float density_per_cell, float height){
         plane = Object();
-        plane.makeObject(make_grid(length,density_per_cell),length*length*6*density_per_cell*density_per_cell,water_shader);
+        //the grid is built and quantized by a worker
+        plane.makeObject([length, density_per_cell](std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+            make_grid(length,density_per_cell,vertices,indices);
+        },water_shader,true,VERTEX_COMPACT);
         glm::vec3 translate_vector = glm::vec3(-length/2,height, -length/2);
         plane.transform.model = glm::translate(plane.transform.model, translate_vector);
     }
@@ -44,69 +50,46 @@ public:
         
     }
 
-    /** Bind your vertex arrays and call glDrawArrays and setup the MVP matrix **/
-    void draw(Camera camera, glm::vec3 materialColour, glm::vec3 light_pos, double now, GLuint sky_texture){
+    /** Bind your vertex arrays and call glDrawArrays and setup the model matrix, the camera, the time and the lights come from the uniform blocks **/
+    void draw(glm::vec3 materialColour, TextureHandle sky_texture){
         water_shader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, sky_texture);
-        water_shader.setInteger("cubemapTexture", 0);
+        sky_texture->bind(UNIT_SKYBOX);
+        water_shader.setInteger("cubemapTexture", UNIT_SKYBOX);
         water_shader.setMatrix4("M", plane.transform.model);
         water_shader.setMatrix4("itM", glm::inverseTranspose(plane.transform.model));
         water_shader.setVector3f("materialColour", materialColour);
-    	water_shader.setMatrix4("V", camera.GetViewMatrix());
-		water_shader.setMatrix4("P", camera.GetProjectionMatrix());
-        water_shader.setVector3f("u_view_pos", camera.Position);
-        water_shader.setVector3f("light.light_pos", light_pos);
-        water_shader.setFloat("time",now);
 
-        plane.draw();
+        plane.draw(water_shader);
     }
 
 private:
-    /** Create a grid based on the length and the density of cells **/
-    std::vector<Vertex> make_grid(int length, float density_per_cell){
-        std::vector<Vertex> vertices;
-        float size = length * density_per_cell;
-        float j,i;
-        float addition = 1 / density_per_cell;
-        for(float q=0; q< size; q++){
-            j = q / density_per_cell;
-            for(float w=0; w<size; w++){
-                i = w / density_per_cell;
-                Vertex v1,v2,v3,v4,v5,v6;
-                v1.Position = glm::vec3(i,0,j+addition);
-                v1.Texture = glm::vec2(0.0);
-                v1.Normal = glm::vec3(0.0,0.0,1.0);
-
-                v2.Position = glm::vec3(i,0,j);
-                v2.Texture = glm::vec2(0.0);
-                v2.Normal = glm::vec3(0.0,0.0,1.0);
-
-                v3.Position = glm::vec3(i+addition,0,j);
-                v3.Texture = glm::vec2(0.0);
-                v3.Normal = glm::vec3(0.0,0.0,1.0);
-
-                v4.Position = glm::vec3(i,0,j+addition);
-                v4.Texture = glm::vec2(0.0);
-                v4.Normal = glm::vec3(0.0,0.0,1.0);
-
-                v5.Position = glm::vec3(i+addition,0,j+addition);
-                v5.Texture = glm::vec2(0.0);
-                v5.Normal = glm::vec3(0.0,0.0,1.0);
-
-                v6.Position = glm::vec3(i+addition,0,j);
-                v6.Texture = glm::vec2(0.0);
-                v6.Normal = glm::vec3(0.0,0.0,1.0);
-
-                vertices.push_back(v1);
-                vertices.push_back(v2);
-                vertices.push_back(v3);
-                vertices.push_back(v4);
-                vertices.push_back(v5);
-                vertices.push_back(v6);
+    /** Create an indexed grid based on the length and the density of cells **/
+    static void make_grid(int length, float density_per_cell, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+        int cells = (int)std::ceil(length * density_per_cell);
+        int row = cells + 1;
+        vertices.clear();
+        indices.clear();
+        vertices.reserve((size_t)row * row);
+        indices.reserve((size_t)cells * cells * 6);
+        for(int q = 0; q <= cells; q++){
+            for(int w = 0; w <= cells; w++){
+                Vertex v;
+                v.Position = glm::vec3(w / density_per_cell, 0, q / density_per_cell);
+                v.Texture = glm::vec2(0.0);
+                v.Normal = glm::vec3(0.0,0.0,1.0);
+                vertices.push_back(v);
+            }
+        }
+        for(int q = 0; q < cells; q++){
+            for(int w = 0; w < cells; w++){
+                uint32_t v00 = q * row + w;         // (i, j)
+                uint32_t v10 = v00 + 1;             // (i + addition, j)
+                uint32_t v01 = v00 + row;           // (i, j + addition)
+                uint32_t v11 = v01 + 1;             // (i + addition, j + addition)
+                uint32_t cell[] = {v01, v00, v10, v01, v11, v10};
+                indices.insert(indices.end(), cell, cell + 6);
             }
         }
-        return vertices;
     }
 };
 #endif
\ No newline at end of file